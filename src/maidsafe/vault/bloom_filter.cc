@@ -0,0 +1,100 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/vault/bloom_filter.h"
+
+#include <algorithm>
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+
+namespace maidsafe {
+
+namespace vault {
+
+namespace {
+
+// About 1% false positives with four hashes.
+const std::uint64_t kCountersPerElement(10);
+// Bounds the filter at 16 MB.
+const std::uint64_t kMaxCounters(std::uint64_t(32) << 20);
+const std::uint32_t kMaxCount(15);
+
+std::uint64_t ReadUint64(const std::vector<byte>& key, std::size_t offset) {
+  std::uint64_t value(0);
+  for (std::size_t i(offset); i != offset + 8 && i < key.size(); ++i)
+    value = (value << 8) | key[i];
+  return value;
+}
+
+}  // unnamed namespace
+
+CountingBloomFilter::CountingBloomFilter(std::uint64_t expected_elements)
+    : kCounterCount_(std::min(std::max<std::uint64_t>(expected_elements, 1024) * kCountersPerElement,
+                              kMaxCounters)),
+      words_(new std::atomic<std::uint32_t>[kCounterCount_ / kCountersPerWord_ + 1]()) {}
+
+void CountingBloomFilter::Add(const std::vector<byte>& key, std::uint32_t salt) {
+  Update(key, salt, true);
+}
+
+void CountingBloomFilter::Remove(const std::vector<byte>& key, std::uint32_t salt) {
+  Update(key, salt, false);
+}
+
+bool CountingBloomFilter::MayContain(const std::vector<byte>& key, std::uint32_t salt) const {
+  for (auto position : Positions(key, salt)) {
+    const std::uint32_t shift(4 * (position % kCountersPerWord_));
+    if (((words_[position / kCountersPerWord_].load() >> shift) & 0xF) == 0)
+      return false;
+  }
+  return true;
+}
+
+std::array<std::uint64_t, CountingBloomFilter::kHashCount_> CountingBloomFilter::Positions(
+    const std::vector<byte>& key, std::uint32_t salt) const {
+  // Double hashing: the i-th position is h1 + i * h2.
+  const std::uint64_t h1(ReadUint64(key, 0) ^ (salt * 0x9e3779b97f4a7c15ULL));
+  const std::uint64_t h2(ReadUint64(key, 8) | 1);
+  std::array<std::uint64_t, kHashCount_> positions;
+  for (std::uint32_t i(0); i != kHashCount_; ++i)
+    positions[i] = (h1 + i * h2) % kCounterCount_;
+  return positions;
+}
+
+void CountingBloomFilter::Update(const std::vector<byte>& key, std::uint32_t salt,
+                                 bool increment) {
+  for (auto position : Positions(key, salt)) {
+    auto& word(words_[position / kCountersPerWord_]);
+    const std::uint32_t shift(4 * (position % kCountersPerWord_));
+    std::uint32_t current(word.load());
+    for (;;) {
+      const std::uint32_t count((current >> shift) & 0xF);
+      // Saturated counters stick, and a zero counter can't belong to a previously added key.
+      if (count == kMaxCount || (!increment && count == 0))
+        break;
+      const std::uint32_t updated(increment ? current + (1U << shift) : current - (1U << shift));
+      if (word.compare_exchange_weak(current, updated))
+        break;
+    }
+  }
+}
+
+}  // namespace vault
+
+}  // namespace maidsafe
@@ -0,0 +1,69 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_VAULT_BLOOM_FILTER_H_
+#define MAIDSAFE_VAULT_BLOOM_FILTER_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "maidsafe/common/types.h"
+
+namespace maidsafe {
+
+namespace vault {
+
+// Counting Bloom filter of 4-bit saturating counters, safe for concurrent use.  Keys must already
+// be uniformly distributed (e.g. hashes), as their leading bytes are used directly as the hash
+// values.  A counter which saturates is never decremented again, so removal can only ever leave
+// false positives, never false negatives.
+class CountingBloomFilter {
+ public:
+  explicit CountingBloomFilter(std::uint64_t expected_elements);
+  CountingBloomFilter(const CountingBloomFilter&) = delete;
+  CountingBloomFilter(CountingBloomFilter&&) = delete;
+  CountingBloomFilter& operator=(const CountingBloomFilter&) = delete;
+  CountingBloomFilter& operator=(CountingBloomFilter&&) = delete;
+
+  void Add(const std::vector<byte>& key, std::uint32_t salt);
+  // Must only be called for keys which were previously added.
+  void Remove(const std::vector<byte>& key, std::uint32_t salt);
+  bool MayContain(const std::vector<byte>& key, std::uint32_t salt) const;
+
+  std::uint64_t CounterCount() const { return kCounterCount_; }
+
+ private:
+  static const std::uint32_t kHashCount_ = 4;
+  static const std::uint32_t kCountersPerWord_ = 8;
+
+  std::array<std::uint64_t, kHashCount_> Positions(const std::vector<byte>& key,
+                                                    std::uint32_t salt) const;
+  void Update(const std::vector<byte>& key, std::uint32_t salt, bool increment);
+
+  const std::uint64_t kCounterCount_;
+  std::unique_ptr<std::atomic<std::uint32_t>[]> words_;
+};
+
+}  // namespace vault
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_VAULT_BLOOM_FILTER_H_
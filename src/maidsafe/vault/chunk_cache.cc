@@ -0,0 +1,213 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/vault/chunk_cache.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace maidsafe {
+
+namespace vault {
+
+namespace {
+
+const std::uint32_t kSketchDepth(4);
+const std::uint8_t kMaxFrequency(15);
+const std::uint64_t kAssumedChunkSize(64 * 1024);
+
+std::uint64_t NextPowerOfTwo(std::uint64_t value) {
+  std::uint64_t result(1);
+  while (result < value)
+    result <<= 1;
+  return result;
+}
+
+}  // unnamed namespace
+
+ChunkCache::FrequencySketch::FrequencySketch(std::uint64_t width)
+    : counters_(static_cast<std::size_t>(width * kSketchDepth), 0),
+      kWidthMask_(static_cast<std::size_t>(width - 1)),
+      kSampleSize_(width * 10),
+      additions_(0) {}
+
+std::size_t ChunkCache::FrequencySketch::Index(std::size_t hash, std::uint32_t row) const {
+  // Derive an independent-enough hash per row by remixing with a row-specific odd multiplier.
+  std::uint64_t mixed((hash + row) * (0x9e3779b97f4a7c15ULL + 2 * row));
+  mixed ^= mixed >> 32;
+  return row * (kWidthMask_ + 1) + (static_cast<std::size_t>(mixed) & kWidthMask_);
+}
+
+void ChunkCache::FrequencySketch::Increment(const std::string& key) {
+  const std::size_t hash(std::hash<std::string>()(key));
+  bool incremented(false);
+  for (std::uint32_t row(0); row != kSketchDepth; ++row) {
+    std::uint8_t& counter(counters_[Index(hash, row)]);
+    if (counter < kMaxFrequency) {
+      ++counter;
+      incremented = true;
+    }
+  }
+  if (incremented && ++additions_ >= kSampleSize_) {
+    for (auto& counter : counters_)
+      counter >>= 1;
+    additions_ /= 2;
+  }
+}
+
+std::uint32_t ChunkCache::FrequencySketch::Estimate(const std::string& key) const {
+  const std::size_t hash(std::hash<std::string>()(key));
+  std::uint32_t estimate(kMaxFrequency);
+  for (std::uint32_t row(0); row != kSketchDepth; ++row)
+    estimate = std::min(estimate, static_cast<std::uint32_t>(counters_[Index(hash, row)]));
+  return estimate;
+}
+
+ChunkCache::ChunkCache(std::uint64_t capacity)
+    : kCapacity_(capacity),
+      kWindowCapacity_(std::max<std::uint64_t>(capacity / 100, 1)),
+      kProtectedCapacity_((capacity - kWindowCapacity_) * 4 / 5),
+      mutex_(),
+      sketch_(NextPowerOfTwo(std::max<std::uint64_t>(capacity / kAssumedChunkSize, 1024))),
+      window_(),
+      probation_(),
+      protected_(),
+      window_bytes_(0),
+      probation_bytes_(0),
+      protected_bytes_(0),
+      entries_(),
+      hits_(0),
+      misses_(0) {}
+
+boost::optional<NonEmptyString> ChunkCache::Get(const std::string& key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  sketch_.Increment(key);
+  auto found(entries_.find(key));
+  if (found == std::end(entries_)) {
+    ++misses_;
+    return boost::none;
+  }
+  ++hits_;
+  auto itr(found->second);
+  switch (itr->segment) {
+    case Segment::kWindow:
+      window_.splice(std::begin(window_), window_, itr);
+      break;
+    case Segment::kProbation:
+      MoveTo(itr, Segment::kProtected);
+      DemoteFromProtected();
+      break;
+    case Segment::kProtected:
+      protected_.splice(std::begin(protected_), protected_, itr);
+      break;
+  }
+  return itr->value;
+}
+
+void ChunkCache::Put(const std::string& key, const NonEmptyString& value) {
+  if (value.size() > kCapacity_ - kWindowCapacity_)
+    return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found(entries_.find(key));
+  if (found != std::end(entries_))
+    Remove(found->second);
+  window_.push_front(Entry{key, value, Segment::kWindow});
+  window_bytes_ += value.size();
+  entries_.emplace(key, std::begin(window_));
+  EvictFromWindow();
+}
+
+void ChunkCache::Erase(const std::string& key) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found(entries_.find(key));
+  if (found != std::end(entries_))
+    Remove(found->second);
+}
+
+std::uint64_t ChunkCache::Size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return window_bytes_ + probation_bytes_ + protected_bytes_;
+}
+
+ChunkCache::EntryList& ChunkCache::List(Segment segment) {
+  switch (segment) {
+    case Segment::kWindow:
+      return window_;
+    case Segment::kProbation:
+      return probation_;
+    default:
+      return protected_;
+  }
+}
+
+std::uint64_t& ChunkCache::Bytes(Segment segment) {
+  switch (segment) {
+    case Segment::kWindow:
+      return window_bytes_;
+    case Segment::kProbation:
+      return probation_bytes_;
+    default:
+      return protected_bytes_;
+  }
+}
+
+void ChunkCache::MoveTo(EntryList::iterator itr, Segment segment) {
+  Bytes(itr->segment) -= itr->value.size();
+  Bytes(segment) += itr->value.size();
+  List(segment).splice(std::begin(List(segment)), List(itr->segment), itr);
+  itr->segment = segment;
+}
+
+void ChunkCache::Remove(EntryList::iterator itr) {
+  Bytes(itr->segment) -= itr->value.size();
+  entries_.erase(itr->key);
+  List(itr->segment).erase(itr);
+}
+
+void ChunkCache::EvictFromWindow() {
+  const std::uint64_t main_capacity(kCapacity_ - kWindowCapacity_);
+  while (window_bytes_ > kWindowCapacity_) {
+    auto candidate(std::prev(std::end(window_)));
+    const std::uint32_t candidate_frequency(sketch_.Estimate(candidate->key));
+    // Make room in the main cache by evicting its least recently used entries, but only while the
+    // candidate is estimated to be more popular than each of them.
+    bool admit(true);
+    while (probation_bytes_ + protected_bytes_ + candidate->value.size() > main_capacity) {
+      EntryList& victims(probation_.empty() ? protected_ : probation_);
+      auto victim(std::prev(std::end(victims)));
+      if (candidate_frequency <= sketch_.Estimate(victim->key)) {
+        admit = false;
+        break;
+      }
+      Remove(victim);
+    }
+    if (admit)
+      MoveTo(candidate, Segment::kProbation);
+    else
+      Remove(candidate);
+  }
+}
+
+void ChunkCache::DemoteFromProtected() {
+  while (protected_bytes_ > kProtectedCapacity_ && protected_.size() > 1)
+    MoveTo(std::prev(std::end(protected_)), Segment::kProbation);
+}
+
+}  // namespace vault
+
+}  // namespace maidsafe
@@ -0,0 +1,107 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_VAULT_CHUNK_CACHE_H_
+#define MAIDSAFE_VAULT_CHUNK_CACHE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "boost/optional/optional.hpp"
+
+#include "maidsafe/common/types.h"
+
+namespace maidsafe {
+
+namespace vault {
+
+// Byte-bounded cache of decrypted chunk values using the W-TinyLFU policy: new entries go into a
+// small LRU window, and an entry leaving the window only displaces the main cache's eviction
+// candidate if it has been requested more often, as estimated by a count-min sketch.  This keeps
+// a one-off scan over many chunks from flushing out the frequently read ones.
+class ChunkCache {
+ public:
+  explicit ChunkCache(std::uint64_t capacity);
+  ChunkCache(const ChunkCache&) = delete;
+  ChunkCache(ChunkCache&&) = delete;
+  ChunkCache& operator=(const ChunkCache&) = delete;
+  ChunkCache& operator=(ChunkCache&&) = delete;
+
+  // Every lookup, hit or miss, counts towards the key's estimated frequency.
+  boost::optional<NonEmptyString> Get(const std::string& key);
+  void Put(const std::string& key, const NonEmptyString& value);
+  void Erase(const std::string& key);
+
+  std::uint64_t Hits() const { return hits_; }
+  std::uint64_t Misses() const { return misses_; }
+  std::uint64_t Size() const;
+
+ private:
+  enum class Segment { kWindow, kProbation, kProtected };
+
+  struct Entry {
+    std::string key;
+    NonEmptyString value;
+    Segment segment;
+  };
+
+  using EntryList = std::list<Entry>;
+
+  // Count-min sketch of 4-bit counters which are halved periodically so that the estimates favour
+  // recent popularity.
+  class FrequencySketch {
+   public:
+    explicit FrequencySketch(std::uint64_t width);
+    void Increment(const std::string& key);
+    std::uint32_t Estimate(const std::string& key) const;
+
+   private:
+    std::size_t Index(std::size_t hash, std::uint32_t row) const;
+    std::vector<std::uint8_t> counters_;
+    const std::size_t kWidthMask_;
+    const std::uint64_t kSampleSize_;
+    std::uint64_t additions_;
+  };
+
+  EntryList& List(Segment segment);
+  std::uint64_t& Bytes(Segment segment);
+  void MoveTo(EntryList::iterator itr, Segment segment);
+  void Remove(EntryList::iterator itr);
+  // Moves entries evicted from the window into the main cache, subject to the admission policy.
+  void EvictFromWindow();
+  void DemoteFromProtected();
+
+  const std::uint64_t kCapacity_, kWindowCapacity_, kProtectedCapacity_;
+  mutable std::mutex mutex_;
+  FrequencySketch sketch_;
+  EntryList window_, probation_, protected_;
+  std::uint64_t window_bytes_, probation_bytes_, protected_bytes_;
+  std::unordered_map<std::string, EntryList::iterator> entries_;
+  std::atomic<std::uint64_t> hits_, misses_;
+};
+
+}  // namespace vault
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_VAULT_CHUNK_CACHE_H_
@@ -0,0 +1,159 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/vault/chunk_scrubber.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "boost/exception/diagnostic_information.hpp"
+
+#include "maidsafe/common/log.h"
+
+namespace maidsafe {
+
+namespace vault {
+
+namespace {
+
+const std::size_t kPageSize(64);
+// However busy the store, a chunk is verified after this many yields, so that a store which is
+// never idle is still scrubbed, albeit slowly.
+const int kMaxYields(100);
+
+}  // unnamed namespace
+
+ChunkScrubber::Options::Options()
+    : bytes_per_second(4 * 1024 * 1024),
+      yield_delay(std::chrono::milliseconds(10)),
+      pass_interval(std::chrono::hours(1)) {}
+
+ChunkScrubber::ChunkScrubber(const ChunkStore& chunk_store, CorruptionFunctor on_corruption,
+                             Options options)
+    : chunk_store_(chunk_store),
+      kOnCorruption_(std::move(on_corruption)),
+      kOptions_(std::move(options)),
+      chunks_verified_(0),
+      chunks_unverifiable_(0),
+      corrupt_chunks_(0),
+      completed_passes_(0),
+      last_operation_count_(chunk_store.OperationCount()),
+      next_read_(std::chrono::steady_clock::now()),
+      mutex_(),
+      condition_(),
+      stopping_(false),
+      thread_([this] { Run(); }) {}
+
+ChunkScrubber::~ChunkScrubber() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  condition_.notify_one();
+  thread_.join();
+}
+
+void ChunkScrubber::Run() {
+  if (!chunk_store_.StoredChunksChecksummed()) {
+    LOG(kWarning) << "Chunks in " << chunk_store_.DiskPath() << " have no checksums, so scrubbing "
+                  << "can only find missing or malformed ones.";
+  }
+  boost::optional<ChunkStore::NameType> resume_after;
+  for (;;) {
+    ChunkStore::NamesPage page;
+    try {
+      page = chunk_store_.GetNamesPage(ChunkStore::NameFilter(), kPageSize, resume_after);
+    } catch (const std::exception& e) {
+      // Start again from the beginning after the usual interval.
+      LOG(kError) << "Failed listing chunks to scrub: " << boost::diagnostic_information(e);
+      page.resume_after = boost::none;
+    }
+    for (const auto& name : page.names) {
+      if (!WaitForIdle() || !WaitUntil(next_read_))
+        return;
+      Verify(name);
+    }
+    resume_after = std::move(page.resume_after);
+    if (!resume_after) {
+      ++completed_passes_;
+      if (!WaitUntil(std::chrono::steady_clock::now() + kOptions_.pass_interval))
+        return;
+    }
+  }
+}
+
+void ChunkScrubber::Verify(const ChunkStore::NameType& obfuscated_name) {
+  std::uint64_t bytes_read(0);
+  maidsafe_error error(MakeError(CommonErrors::success));
+  try {
+    bytes_read = chunk_store_.VerifyStoredChunk(obfuscated_name);
+  } catch (const maidsafe_error& e) {
+    error = e;
+  } catch (const std::exception& e) {
+    LOG(kError) << boost::diagnostic_information(e);
+    error = MakeError(CommonErrors::unable_to_handle_request);
+  }
+
+  // Reading at least costs a seek, even when the chunk has gone.
+  const auto read_time(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(static_cast<double>(std::max<std::uint64_t>(bytes_read, 1)) /
+                                    std::max<std::uint64_t>(kOptions_.bytes_per_second, 1))));
+  next_read_ = std::max(next_read_, std::chrono::steady_clock::now()) + read_time;
+
+  if (error.code() == make_error_code(CommonErrors::success)) {
+    if (chunk_store_.StoredChunksChecksummed())
+      ++chunks_verified_;
+    else
+      ++chunks_unverifiable_;
+    return;
+  }
+  // Deleted since being listed.
+  if (error.code() == make_error_code(CommonErrors::no_such_element))
+    return;
+  ++corrupt_chunks_;
+  LOG(kWarning) << "Scrubbing found " << obfuscated_name.name << " to be corrupt.";
+  if (!kOnCorruption_)
+    return;
+  try {
+    kOnCorruption_(obfuscated_name, error);
+  } catch (const std::exception& e) {
+    LOG(kError) << "Corruption handler failed: " << boost::diagnostic_information(e);
+  }
+}
+
+bool ChunkScrubber::WaitUntil(std::chrono::steady_clock::time_point time) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  return !condition_.wait_until(lock, time, [&] { return stopping_; });
+}
+
+bool ChunkScrubber::WaitForIdle() {
+  for (int i(0); i != kMaxYields; ++i) {
+    const std::uint64_t operation_count(chunk_store_.OperationCount());
+    if (operation_count == last_operation_count_)
+      return true;
+    last_operation_count_ = operation_count;
+    if (!WaitUntil(std::chrono::steady_clock::now() + kOptions_.yield_delay))
+      return false;
+  }
+  return true;
+}
+
+}  // namespace vault
+
+}  // namespace maidsafe
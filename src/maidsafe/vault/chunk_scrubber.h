@@ -0,0 +1,96 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_VAULT_CHUNK_SCRUBBER_H_
+#define MAIDSAFE_VAULT_CHUNK_SCRUBBER_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "maidsafe/common/error.h"
+
+#include "maidsafe/vault/chunk_store.h"
+
+namespace maidsafe {
+
+namespace vault {
+
+// Walks a ChunkStore in the background a page of names at a time, verifying each chunk's stored
+// form (see ChunkStore::VerifyStoredChunk) so that corruption is found before a client asks for
+// the chunk.  Chunks in a store without checksums (see ChunkStore::StoredChunksChecksummed) can
+// only be checked for being well formed, so are counted as unverifiable rather than verified.
+// Reads are paced to 'bytes_per_second', and while the store is serving other operations the
+// scrubber backs off for 'yield_delay' at a time.  After each complete pass, it sleeps for
+// 'pass_interval' before starting again.
+class ChunkScrubber {
+ public:
+  struct Options {
+    Options();
+    std::uint64_t bytes_per_second;
+    std::chrono::milliseconds yield_delay, pass_interval;
+  };
+
+  // Called on the scrubber's thread with the obfuscated name of each chunk which fails
+  // verification.  Owners knowing the network names can match them by obfuscating those.
+  using CorruptionFunctor =
+      std::function<void(const ChunkStore::NameType& obfuscated_name, const maidsafe_error&)>;
+
+  ChunkScrubber(const ChunkStore& chunk_store, CorruptionFunctor on_corruption,
+                Options options = Options());
+  ~ChunkScrubber();
+  ChunkScrubber(const ChunkScrubber&) = delete;
+  ChunkScrubber(ChunkScrubber&&) = delete;
+  ChunkScrubber& operator=(const ChunkScrubber&) = delete;
+  ChunkScrubber& operator=(ChunkScrubber&&) = delete;
+
+  std::uint64_t ChunksVerified() const { return chunks_verified_; }
+  std::uint64_t ChunksUnverifiable() const { return chunks_unverifiable_; }
+  std::uint64_t CorruptChunks() const { return corrupt_chunks_; }
+  std::uint64_t CompletedPasses() const { return completed_passes_; }
+
+ private:
+  void Run();
+  void Verify(const ChunkStore::NameType& obfuscated_name);
+  // Each returns false if the scrubber is stopping.
+  bool WaitUntil(std::chrono::steady_clock::time_point time);
+  bool WaitForIdle();
+
+  const ChunkStore& chunk_store_;
+  const CorruptionFunctor kOnCorruption_;
+  const Options kOptions_;
+  std::atomic<std::uint64_t> chunks_verified_, chunks_unverifiable_, corrupt_chunks_,
+      completed_passes_;
+  // The store's operation count when last checked, and when the next read is due under the budget.
+  std::uint64_t last_operation_count_;
+  std::chrono::steady_clock::time_point next_read_;
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  bool stopping_;
+  std::thread thread_;
+};
+
+}  // namespace vault
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_VAULT_CHUNK_SCRUBBER_H_
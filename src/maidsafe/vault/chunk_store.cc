@@ -19,14 +19,28 @@
 #include "maidsafe/vault/chunk_store.h"
 
 #include <algorithm>
+#include <array>
+#include <cmath>
+#include <fstream>
 #include <future>
+#include <iomanip>
+#include <sstream>
+#include <thread>
 
 #include "boost/filesystem/convenience.hpp"
 #include "boost/lexical_cast.hpp"
+#include "boost/optional/optional.hpp"
 
+#include "maidsafe/common/convert.h"
 #include "maidsafe/common/crypto.h"
 #include "maidsafe/common/log.h"
 #include "maidsafe/common/utils.h"
+#include "maidsafe/common/serialisation/serialisation.h"
+
+#include "maidsafe/vault/crc32c.h"
+#include "maidsafe/vault/direct_io.h"
+#include "maidsafe/vault/file_sync.h"
+#include "maidsafe/vault/open_roots.h"
 
 namespace fs = boost::filesystem;
 
@@ -36,6 +50,570 @@ namespace vault {
 
 namespace {
 
+const std::uint32_t kUsageLedgerVersion(1);
+// Version 1 manifests predate chunk formats.
+const std::uint32_t kManifestVersion(2);
+// Chunks are stored as bare ciphertext in stores created before compression was added, and are
+// otherwise prefixed by a flags byte.  Stores created since chunk headers were added precede that
+// with a header (see below).
+const std::uint32_t kRawChunkFormat(1), kFlaggedChunkFormat(2), kHeaderedChunkFormat(3);
+const byte kCompressedFlag(0x01), kSegmentedFlag(0x02);
+// A chunk header holds its version, a copy of the flags, the value's size, then the size and
+// CRC-32C of the remainder (the body, laid out as in kFlaggedChunkFormat), so that stored chunks
+// can be checked without being decrypted.  The version allows the layout of individual chunks to
+// change later without rewriting the store.
+const std::size_t kChunkHeaderSize(1 + 1 + 2 + 8 + 8 + 4);
+const byte kChunkHeaderVersion(1);
+// A segmented chunk's flags byte is followed by its segment size, value size and segment count,
+// then the size of each encrypted segment, and then the segments themselves.  All integers are
+// little-endian.
+const std::size_t kSegmentHeaderSize(1 + 4 + 8 + 4), kSegmentSizeFieldSize(4);
+// Guards against allocating a huge table when parsing a corrupt header (this still allows
+// values of a terabyte in 64KiB segments).
+const std::uint64_t kMaxSegmentCount(1 << 24);
+const std::uint32_t kDefaultSegmentSize(64 * 1024);
+// Smaller chunks aren't worth compressing, nor are those whose sampled byte entropy is close to
+// that of random data, such as ImmutableData which has already been self-encrypted.
+const std::size_t kMinCompressibleSize(512);
+const std::size_t kEntropySampleSize(4096);
+const double kMaxCompressibleEntropy(7.5);
+// Compressed values are only kept if they save at least 1/16th.
+const std::size_t kMinCompressionSavingShift(4);
+// Favours speed, as this is on the Put path.
+const int kCompressionLevel(1);
+// The original file-per-chunk layout: five levels of single hex character directories, created
+// on demand.
+const std::uint32_t kLegacyDirectoryWidth(1), kLegacyDirectoryDepth(5);
+// Limits the number of precreated directories to 16^4.
+const std::uint32_t kMaxDirectoryCharacters(4);
+// Suffix of chunks written to temporary files by kAtomic and kGroupCommit.
+const char kStagedExtension[] = ".staged";
+// Used to size the existence filter from the max disk usage.
+const std::uint64_t kExpectedChunkSize(256 * 1024);
+
+fs::path UsageLedgerPath(const fs::path& disk_root) { return disk_root / "usage_ledger"; }
+
+fs::path ManifestPath(const fs::path& disk_root) { return disk_root / "manifest"; }
+
+// True for the store's own bookkeeping files (and their temporaries) in the disk root.
+bool IsMetadataFile(const fs::path& path) {
+  const std::string file_name(path.filename().string());
+  return file_name.compare(0, 12, "usage_ledger") == 0 || file_name.compare(0, 8, "manifest") == 0;
+}
+
+// Writes to a temporary file which is then renamed over 'path', so readers never see a partially
+// written file.
+bool WriteFileAtomically(const fs::path& path, const std::string& contents) {
+  fs::path temp_path(path.string() + ".tmp");
+  boost::system::error_code error_code;
+  if (!WriteFile(temp_path, convert::ToByteVector(contents))) {
+    LOG(kWarning) << "Failed to write " << temp_path;
+    return false;
+  }
+  fs::rename(temp_path, path, error_code);
+  if (error_code) {
+    LOG(kWarning) << "Failed to rename " << temp_path << " to " << path << ": "
+                  << error_code.message();
+    fs::remove(temp_path, error_code);
+    return false;
+  }
+  return true;
+}
+
+// The ledger is removed as soon as it has been read and is only rewritten on a clean shutdown, so
+// after a crash it is missing and the store falls back to rescanning the disk root.
+boost::optional<DiskUsage> ConsumeUsageLedger(const fs::path& disk_root) {
+  auto ledger_path(UsageLedgerPath(disk_root));
+  auto contents(ReadFile(ledger_path));
+  boost::system::error_code error_code;
+  fs::remove(ledger_path, error_code);
+  if (!contents)
+    return boost::none;
+  try {
+    std::uint32_t version(0);
+    std::uint64_t usage(0);
+    ConvertFromString(convert::ToString(*contents), version, usage);
+    if (version == kUsageLedgerVersion)
+      return DiskUsage(usage);
+    LOG(kWarning) << "Ignoring usage ledger " << ledger_path << " with version " << version;
+  } catch (const std::exception& e) {
+    LOG(kWarning) << "Ignoring unparseable usage ledger " << ledger_path << ": "
+                  << boost::diagnostic_information(e);
+  }
+  return boost::none;
+}
+
+void WriteUsageLedger(const fs::path& disk_root, std::uint64_t usage) {
+  WriteFileAtomically(UsageLedgerPath(disk_root), ConvertToString(kUsageLedgerVersion, usage));
+}
+
+std::string HexDirectoryName(std::uint32_t index, std::uint32_t width) {
+  std::ostringstream stream;
+  stream << std::hex << std::setw(width) << std::setfill('0') << index;
+  return stream.str();
+}
+
+void PrecreateDirectories(const fs::path& disk_root, std::uint32_t width, std::uint32_t depth) {
+  const std::uint32_t fanout(1U << (4 * width));
+  std::vector<fs::path> level(1, disk_root);
+  for (std::uint32_t i(0); i != depth; ++i) {
+    std::vector<fs::path> next_level;
+    next_level.reserve(level.size() * fanout);
+    for (const auto& parent : level) {
+      for (std::uint32_t j(0); j != fanout; ++j) {
+        next_level.push_back(parent / HexDirectoryName(j, width));
+        boost::system::error_code error_code;
+        fs::create_directory(next_level.back(), error_code);
+        if (error_code) {
+          LOG(kError) << "Failed to create " << next_level.back() << ": " << error_code.message();
+          BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+        }
+      }
+    }
+    level.swap(next_level);
+  }
+}
+
+void WriteManifest(const fs::path& disk_root, std::uint32_t width, std::uint32_t depth,
+                   bool migrating, std::uint32_t chunk_format) {
+  if (!WriteFileAtomically(ManifestPath(disk_root), ConvertToString(kManifestVersion, width, depth,
+                                                                    migrating, chunk_format))) {
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+  }
+}
+
+bool IsStagedFile(const fs::path& path) { return path.extension() == kStagedExtension; }
+
+void DiscardStagedChunk(const fs::path& staged_path) {
+  if (staged_path.empty())
+    return;
+  boost::system::error_code error_code;
+  fs::remove(staged_path, error_code);
+}
+
+// Parses the type id suffix of a chunk's file name, rejecting anything else.
+boost::optional<std::uint32_t> ParseTypeId(const std::string& type_id) {
+  try {
+    std::size_t length(0);
+    const unsigned long value(std::stoul(type_id, &length));  // NOLINT (Fraser)
+    if (length == type_id.size())
+      return static_cast<std::uint32_t>(value);
+  } catch (const std::exception&) {}
+  return boost::none;
+}
+
+std::uint64_t ExistingFileSize(const fs::path& path) {
+  boost::system::error_code error_code;
+  if (!fs::exists(path, error_code)) {
+    if (error_code && error_code != boost::system::errc::no_such_file_or_directory) {
+      LOG(kError) << "Unable to determine file status for " << path << ": "
+                  << error_code.message();
+      BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+    }
+    return 0;
+  }
+  std::uint64_t file_size(fs::file_size(path, error_code));
+  if (error_code) {
+    LOG(kError) << "Error getting file size of " << path << ": " << error_code.message();
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+  }
+  return file_size;
+}
+
+std::uint64_t RemoveChunkFile(const fs::path& path) {
+  boost::system::error_code error_code;
+  std::uint64_t file_size(fs::file_size(path, error_code));
+  if (error_code) {
+    LOG(kError) << "Error getting file size of " << path << ": " << error_code.message();
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+  }
+  if (!fs::remove(path, error_code) || error_code) {
+    LOG(kError) << "Error removing " << path << ": " << error_code.message();
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+  }
+  return file_size;
+}
+
+template <typename Operation>
+maidsafe_error RunForError(Operation operation) {
+  try {
+    operation();
+    return MakeError(CommonErrors::success);
+  } catch (const maidsafe_error& error) {
+    return error;
+  } catch (const std::exception& e) {
+    LOG(kError) << boost::diagnostic_information(e);
+    return MakeError(CommonErrors::unable_to_handle_request);
+  }
+}
+
+std::vector<byte> ChunkKeyAndIVBytes(const ChunkStore::NameType& name) {
+  const auto& name_str(name.name.string());
+  return std::vector<byte>(name_str.begin(),
+                           name_str.begin() + crypto::AES256_KeySize + crypto::AES256_IVSize);
+}
+
+crypto::AES256KeyAndIV ChunkKeyAndIV(const ChunkStore::NameType& name) {
+  return crypto::AES256KeyAndIV(ChunkKeyAndIVBytes(name));
+}
+
+// The segments of a chunk share its key, so each is given its own IV by mixing its index into the
+// chunk's.  The index is offset by one so that no segment reuses the IV of an unsegmented value.
+crypto::AES256KeyAndIV SegmentKeyAndIV(const ChunkStore::NameType& name, std::uint64_t index) {
+  auto key_and_iv(ChunkKeyAndIVBytes(name));
+  ++index;
+  for (std::size_t i(0); i != 4; ++i)
+    key_and_iv[key_and_iv.size() - 1 - i] ^= static_cast<byte>(index >> (8 * i));
+  return crypto::AES256KeyAndIV(std::move(key_and_iv));
+}
+
+void WriteInteger(std::uint64_t value, std::size_t size, byte* output) {
+  for (std::size_t i(0); i != size; ++i)
+    output[i] = static_cast<byte>(value >> (8 * i));
+}
+
+std::uint64_t ReadInteger(const byte* input, std::size_t size) {
+  std::uint64_t value(0);
+  for (std::size_t i(0); i != size; ++i)
+    value |= static_cast<std::uint64_t>(input[i]) << (8 * i);
+  return value;
+}
+
+struct SegmentTable {
+  std::size_t HeaderSize() const {
+    return kSegmentHeaderSize + kSegmentSizeFieldSize * cipher_sizes.size();
+  }
+  // The offset in the stored content of the segment at 'index'.
+  std::uint64_t SegmentOffset(std::uint64_t index) const {
+    std::uint64_t offset(HeaderSize());
+    for (std::uint64_t i(0); i != index; ++i)
+      offset += cipher_sizes[i];
+    return offset;
+  }
+  std::uint32_t segment_size;
+  std::uint64_t value_size;
+  std::vector<std::uint32_t> cipher_sizes;
+};
+
+// Parses the fixed part of a segmented chunk's header, which must be the start of 'content'.  The
+// table of sizes is only filled in if 'content' includes it.  Throws parsing_error if malformed.
+SegmentTable ParseSegmentHeader(const byte* content, std::size_t size) {
+  if (size < kSegmentHeaderSize || content[0] != kSegmentedFlag)
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::parsing_error));
+  SegmentTable table;
+  table.segment_size = static_cast<std::uint32_t>(ReadInteger(&content[1], 4));
+  table.value_size = ReadInteger(&content[5], 8);
+  const std::uint64_t count(ReadInteger(&content[13], 4));
+  if (table.segment_size == 0 || count == 0 || count > kMaxSegmentCount ||
+      (table.value_size + table.segment_size - 1) / table.segment_size != count) {
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::parsing_error));
+  }
+  table.cipher_sizes.resize(static_cast<std::size_t>(count));
+  if (size >= table.HeaderSize()) {
+    for (std::size_t i(0); i != table.cipher_sizes.size(); ++i) {
+      table.cipher_sizes[i] = static_cast<std::uint32_t>(
+          ReadInteger(&content[kSegmentHeaderSize + kSegmentSizeFieldSize * i], 4));
+    }
+  }
+  return table;
+}
+
+SegmentTable ParseSegmentHeader(const std::vector<byte>& content) {
+  return ParseSegmentHeader(content.data(), content.size());
+}
+
+// Where the body starts in chunks stored in 'chunk_format'.
+std::size_t BodyOffset(std::uint32_t chunk_format) {
+  return chunk_format == kHeaderedChunkFormat ? kChunkHeaderSize : 0;
+}
+
+// Fills in the header reserved at the front of 'content', which must be followed by the body.
+void WriteChunkHeader(std::uint64_t value_size, std::vector<byte>& content) {
+  const std::size_t body_size(content.size() - kChunkHeaderSize);
+  content[0] = kChunkHeaderVersion;
+  content[1] = content[kChunkHeaderSize];
+  content[2] = content[3] = 0;
+  WriteInteger(value_size, 8, &content[4]);
+  WriteInteger(body_size, 8, &content[12]);
+  WriteInteger(Crc32c(&content[kChunkHeaderSize], body_size), 4, &content[20]);
+}
+
+// True if 'content' is a whole chunk whose header matches its body.
+bool ChunkHeaderMatches(const std::vector<byte>& content) {
+  return content.size() > kChunkHeaderSize && content[0] == kChunkHeaderVersion &&
+         content[1] == content[kChunkHeaderSize] &&
+         ReadInteger(&content[12], 8) == content.size() - kChunkHeaderSize &&
+         ReadInteger(&content[20], 4) ==
+             Crc32c(&content[kChunkHeaderSize], content.size() - kChunkHeaderSize);
+}
+
+// Throws parsing_error unless 'content' is a whole chunk whose header matches its body.
+void CheckChunkHeader(const std::vector<byte>& content) {
+  if (!ChunkHeaderMatches(content))
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::parsing_error));
+}
+
+// Throws parsing_error unless 'content' could have been written in 'chunk_format'.  Without the
+// name, the ciphertext itself can't be checked beyond its being present, or matching its checksum
+// if the chunk has a header.
+void CheckStoredContent(const std::vector<byte>& content, std::uint32_t chunk_format) {
+  if (chunk_format == kRawChunkFormat) {
+    if (content.empty())
+      BOOST_THROW_EXCEPTION(MakeError(CommonErrors::parsing_error));
+    return;
+  }
+  if (chunk_format == kHeaderedChunkFormat)
+    CheckChunkHeader(content);
+  const std::size_t body_offset(BodyOffset(chunk_format));
+  if (content.size() <= body_offset + 1)
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::parsing_error));
+  const byte* body(&content[body_offset]);
+  const std::size_t body_size(content.size() - body_offset);
+  if (body[0] == 0 || body[0] == kCompressedFlag)
+    return;
+  const auto table(ParseSegmentHeader(body, body_size));
+  if (body_size < table.HeaderSize() ||
+      table.SegmentOffset(table.cipher_sizes.size()) != body_size) {
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::parsing_error));
+  }
+}
+
+// Appends the segmented body to 'content'.
+void EncodeSegments(const ChunkStore::NameType& name, const std::vector<byte>& value,
+                    std::uint32_t segment_size, std::vector<byte>& content) {
+  const std::size_t count((value.size() + segment_size - 1) / segment_size);
+  const std::size_t body_offset(content.size());
+  content.resize(body_offset + kSegmentHeaderSize + kSegmentSizeFieldSize * count);
+  content.reserve(content.size() + value.size() + count * crypto::AES256_IVSize);
+  content[body_offset] = kSegmentedFlag;
+  WriteInteger(segment_size, 4, &content[body_offset + 1]);
+  WriteInteger(value.size(), 8, &content[body_offset + 5]);
+  WriteInteger(count, 4, &content[body_offset + 13]);
+  for (std::size_t i(0); i != count; ++i) {
+    const auto begin(std::begin(value) + i * segment_size);
+    const auto end(i + 1 == count ? std::end(value) : begin + segment_size);
+    auto cipher_text(crypto::SymmEncrypt(NonEmptyString(std::vector<byte>(begin, end)),
+                                         SegmentKeyAndIV(name, i)));
+    const auto& cipher_bytes(cipher_text.data.string());
+    WriteInteger(cipher_bytes.size(), 4,
+                 &content[body_offset + kSegmentHeaderSize + kSegmentSizeFieldSize * i]);
+    content.insert(std::end(content), std::begin(cipher_bytes), std::end(cipher_bytes));
+  }
+}
+
+// Decrypts the segment at 'index' from 'cipher_bytes' and appends the part of it within
+// ['first', 'last') of the value to 'output'.
+void DecodeSegment(const ChunkStore::NameType& name, const SegmentTable& table,
+                   std::uint64_t index, const byte* cipher_bytes, std::uint64_t first,
+                   std::uint64_t last, std::vector<byte>& output) {
+  auto plain_text(crypto::SymmDecrypt(
+      crypto::CipherText(NonEmptyString(
+          std::vector<byte>(cipher_bytes, cipher_bytes + table.cipher_sizes[index]))),
+      SegmentKeyAndIV(name, index)));
+  const auto& plain_bytes(plain_text.string());
+  const std::uint64_t segment_begin(index * table.segment_size);
+  if (plain_bytes.size() !=
+      std::min<std::uint64_t>(table.segment_size, table.value_size - segment_begin)) {
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::parsing_error));
+  }
+  first = std::max(first, segment_begin) - segment_begin;
+  last = std::min<std::uint64_t>(last - segment_begin, plain_bytes.size());
+  output.insert(std::end(output), std::begin(plain_bytes) + first, std::begin(plain_bytes) + last);
+}
+
+std::vector<byte> Slice(const std::vector<byte>& value, std::uint64_t offset,
+                        std::uint64_t length) {
+  offset = std::min<std::uint64_t>(offset, value.size());
+  length = std::min<std::uint64_t>(length, value.size() - offset);
+  return std::vector<byte>(std::begin(value) + offset, std::begin(value) + offset + length);
+}
+
+// Estimates the order-0 entropy in bits per byte from an evenly spaced sample of 'value'.
+double SampledEntropy(const std::vector<byte>& value) {
+  const std::size_t step(std::max<std::size_t>(value.size() / kEntropySampleSize, 1));
+  std::array<std::uint32_t, 256> counts{};
+  std::size_t sample_size(0);
+  for (std::size_t i(0); i < value.size(); i += step, ++sample_size)
+    ++counts[value[i]];
+  double entropy(0.0);
+  for (auto count : counts) {
+    if (count != 0) {
+      const double probability(static_cast<double>(count) / sample_size);
+      entropy -= probability * std::log2(probability);
+    }
+  }
+  return entropy;
+}
+
+boost::optional<NonEmptyString> Compress(const NonEmptyString& value) {
+  const auto& bytes(value.string());
+  if (bytes.size() < kMinCompressibleSize || SampledEntropy(bytes) > kMaxCompressibleEntropy)
+    return boost::none;
+  auto compressed(crypto::Compress(crypto::UncompressedText(value), kCompressionLevel));
+  if (compressed.data.size() > bytes.size() - (bytes.size() >> kMinCompressionSavingShift))
+    return boost::none;
+  return compressed.data;
+}
+
+std::string CacheKey(const ChunkStore::NameType& name) {
+  const auto& name_bytes(name.name.string());
+  return std::string(std::begin(name_bytes), std::end(name_bytes)) +
+         std::to_string(name.type_id.data);
+}
+
+// Splits "<hex name>_<type id>" as used for chunk files.
+boost::optional<ChunkStore::NameType> ParseFileName(const std::string& file_name) {
+  const std::size_t index(file_name.rfind('_'));
+  if (index == std::string::npos)
+    return boost::none;
+  auto type_id(ParseTypeId(file_name.substr(index + 1)));
+  if (!type_id)
+    return boost::none;
+  try {
+    return ChunkStore::NameType(Identity(hex::DecodeToBytes(file_name.substr(0, index))),
+                                DataTypeId(*type_id));
+  } catch (const std::exception&) {
+    return boost::none;
+  }
+}
+
+std::string HexName(const Identity& name) { return hex::Encode(name.string()); }
+
+// Walks the file-per-chunk directory tree applying a NameFilter.  Each directory is named by a
+// prefix of the hex encoded names below it, so whole subtrees outside the filter's range (or
+// before the resume point) are skipped without being listed.
+class NameWalker {
+ public:
+  using NameType = ChunkStore::NameType;
+  using Visitor = std::function<bool(const NameType&)>;
+  using Directories = std::vector<std::pair<fs::path, std::string>>;
+
+  NameWalker(const ChunkStore::NameFilter& filter, const boost::optional<NameType>& resume_after)
+      : kTypeId_(filter.type_id),
+        kFirst_(filter.first ? HexName(*filter.first) : std::string()),
+        kLast_(filter.last ? HexName(*filter.last) : std::string()),
+        kResumeName_(resume_after ? HexName(resume_after->name) : std::string()),
+        kResumeType_(resume_after ? resume_after->type_id.data : 0),
+        kLowerBound_(std::max(kFirst_, kResumeName_)) {}
+
+  bool Accepts(const NameType& name) const {
+    return Accepts(HexName(name.name), name.type_id.data);
+  }
+
+  // Visits the chunks directly within 'directory' in no particular order, and returns its
+  // subdirectories which may hold matching chunks, each paired with its prefix.  If 'recurse', or
+  // if 'visitor' stops the walk, the subdirectories are visited likewise or not at all instead, and
+  // none are returned.
+  Directories Walk(const fs::path& directory, const std::string& prefix, bool recurse,
+                   const Visitor& visitor) const {
+    Directories subdirectories;
+    if (!Visit(directory, prefix, recurse, visitor, subdirectories) || recurse)
+      return Directories();
+    return subdirectories;
+  }
+
+  bool Beyond(const NameType& name) const {
+    return !kLast_.empty() && HexName(name.name) >= kLast_;
+  }
+
+  // As above, but recursive and in ascending name order.  Returns false if 'visitor' stopped the
+  // walk.
+  bool WalkInOrder(const fs::path& directory, const std::string& prefix,
+                   const Visitor& visitor) const {
+    std::vector<std::string> files, subdirectories;
+    for (fs::directory_iterator itr(directory); itr != fs::directory_iterator(); ++itr) {
+      std::string entry(itr->path().filename().string());
+      if (fs::is_directory(itr->status())) {
+        if (!Excludes(prefix + entry))
+          subdirectories.push_back(std::move(entry));
+      } else if (!(prefix.empty() && IsMetadataFile(itr->path()))) {
+        files.push_back(std::move(entry));
+      }
+    }
+    std::vector<NameType> names;
+    for (const auto& file : files) {
+      auto name(Parse(prefix, file));
+      if (name)
+        names.push_back(std::move(*name));
+    }
+    std::sort(std::begin(names), std::end(names));
+    for (const auto& name : names) {
+      if (!visitor(name))
+        return false;
+    }
+    std::sort(std::begin(subdirectories), std::end(subdirectories));
+    for (const auto& subdirectory : subdirectories) {
+      if (!WalkInOrder(directory / subdirectory, prefix + subdirectory, visitor))
+        return false;
+    }
+    return true;
+  }
+
+ private:
+  // Implements Walk(), filling in 'subdirectories'.  Returns false if 'visitor' stopped the walk.
+  bool Visit(const fs::path& directory, const std::string& prefix, bool recurse,
+             const Visitor& visitor, Directories& subdirectories) const {
+    for (fs::directory_iterator itr(directory); itr != fs::directory_iterator(); ++itr) {
+      const std::string entry(itr->path().filename().string());
+      if (fs::is_directory(itr->status())) {
+        if (!Excludes(prefix + entry))
+          subdirectories.emplace_back(itr->path(), prefix + entry);
+      } else if (!(prefix.empty() && IsMetadataFile(itr->path()))) {
+        auto name(Parse(prefix, entry));
+        if (name && !visitor(*name))
+          return false;
+      }
+    }
+    if (!recurse)
+      return true;
+    for (const auto& subdirectory : subdirectories) {
+      Directories nested;
+      if (!Visit(subdirectory.first, subdirectory.second, true, visitor, nested))
+        return false;
+    }
+    return true;
+  }
+
+  boost::optional<NameType> Parse(const std::string& prefix, const std::string& entry) const {
+    // The type and range are checked before the name is decoded.
+    const std::size_t index(entry.rfind('_'));
+    if (index == std::string::npos)
+      return boost::none;
+    auto type_id(ParseTypeId(entry.substr(index + 1)));
+    if (!type_id)
+      return boost::none;
+    std::string hex_name(prefix);
+    hex_name.append(entry, 0, index);
+    if (!Accepts(hex_name, *type_id))
+      return boost::none;
+    try {
+      return NameType(Identity(hex::DecodeToBytes(hex_name)), DataTypeId(*type_id));
+    } catch (const std::exception&) {
+      return boost::none;
+    }
+  }
+
+  bool Accepts(const std::string& hex_name, std::uint32_t type_id) const {
+    if (kTypeId_ && kTypeId_->data != type_id)
+      return false;
+    if (hex_name < kFirst_ || (!kLast_.empty() && hex_name >= kLast_))
+      return false;
+    return kResumeName_.empty() || hex_name > kResumeName_ ||
+           (hex_name == kResumeName_ && type_id > kResumeType_);
+  }
+
+  // True if no name starting with 'prefix' can be within range.
+  bool Excludes(const std::string& prefix) const {
+    return prefix < kLowerBound_.substr(0, prefix.size()) ||
+           (!kLast_.empty() && prefix > kLast_.substr(0, prefix.size()));
+  }
+
+  const boost::optional<DataTypeId> kTypeId_;
+  const std::string kFirst_, kLast_, kResumeName_;
+  const std::uint32_t kResumeType_;
+  const std::string kLowerBound_;
+};
+
 struct UsedSpace {
   UsedSpace() : directories(), disk_usage(0) {}
   UsedSpace(UsedSpace&& other)
@@ -49,10 +627,15 @@ UsedSpace GetUsedSpace(fs::path directory) {
   UsedSpace used_space;
   try {
     for (fs::directory_iterator it(directory); it != fs::directory_iterator(); ++it) {
-      if (fs::is_directory(*it))
+      if (fs::is_directory(*it)) {
         used_space.directories.push_back(it->path());
-      else
+      } else if (IsStagedFile(it->path())) {
+        // Left by a Put interrupted by a crash.
+        boost::system::error_code error_code;
+        fs::remove(it->path(), error_code);
+      } else if (!IsMetadataFile(it->path())) {
         used_space.disk_usage.data += fs::file_size(*it);
+      }
     }
   } catch (const std::exception& e) {
     LOG(kError) << "GetUsedSpace when handling " << directory
@@ -71,6 +654,14 @@ DiskUsage InitialiseDiskRoot(const fs::path& disk_root) {
       BOOST_THROW_EXCEPTION(MakeError(CommonErrors::uninitialised));
     }
   } else {
+    if (fs::is_directory(disk_root, error_code)) {
+      fs::remove(UsageLedgerPath(disk_root).string() + ".tmp", error_code);
+      fs::remove(ManifestPath(disk_root).string() + ".tmp", error_code);
+      auto ledger_usage(ConsumeUsageLedger(disk_root));
+      if (ledger_usage)
+        return *ledger_usage;
+      LOG(kInfo) << "No valid usage ledger in " << disk_root << ", rescanning.";
+    }
     std::vector<fs::path> dirs_to_do;
     dirs_to_do.push_back(disk_root);
     while (!dirs_to_do.empty()) {
@@ -104,173 +695,1188 @@ DiskUsage InitialiseDiskRoot(const fs::path& disk_root) {
 
 }  // unnamed namespace
 
-ChunkStore::ChunkStore(const fs::path& disk_path, DiskUsage max_disk_usage)
+ChunkStore::Options::Options()
+    : backend(Backend::kFilePerChunk),
+      cache_capacity(0),
+      directory_width(2),
+      directory_depth(1),
+      compression(false),
+      segment_size(kDefaultSegmentSize),
+      direct_io_threshold(0),
+      durability(Durability::kBuffered),
+      group_commit_window(2),
+      group_commit_size(64) {}
+
+ChunkStore::ChunkStore(const fs::path& disk_path, DiskUsage max_disk_usage, Options options)
     : kDiskPath_(disk_path),
-      max_disk_usage_(std::move(max_disk_usage)),
-      current_disk_usage_(InitialiseDiskRoot(kDiskPath_)),
-      kDepth_(5),
-      mutex_() {
+      pack_store_(options.backend == Backend::kPackFile ? new PackStore(kDiskPath_) : nullptr),
+      cache_(options.cache_capacity != 0 ? new ChunkCache(options.cache_capacity) : nullptr),
+      max_disk_usage_(max_disk_usage.data),
+      current_disk_usage_(pack_store_ ? 0 : InitialiseDiskRoot(kDiskPath_).data),
+      kLayout_(InitialiseLayout(kDiskPath_, options, pack_store_.get())),
+      kCompression_(options.compression && kLayout_.chunk_format != kRawChunkFormat),
+      kSegmentSize_(kLayout_.chunk_format != kRawChunkFormat ? options.segment_size : 0),
+      kDirectIoThreshold_(options.direct_io_threshold),
+      kDurability_(options.durability),
+      staged_count_(0),
+      operation_count_(0),
+      avoided_writes_(0),
+      metrics_(),
+      group_committer_(),
+      existence_filter_(pack_store_ ? nullptr : new CountingBloomFilter(max_disk_usage.data /
+                                                                         kExpectedChunkSize)),
+      migrating_(kLayout_.migrating),
+      existence_filter_ready_(false),
+      stop_background_(false),
+      background_thread_(),
+      stripes_(),
+      generations_(),
+      io_threads_flag_(),
+      io_threads_() {
+  // Space freed by compaction may be reported before the size is added, but never counted twice.
+  if (pack_store_) {
+    current_disk_usage_ += pack_store_->WatchReclaimed(
+        [this](std::uint64_t freed) { ReleaseDiskSpace(freed); });
+    // Deletes may have left the pack file over the max.
+    if (current_disk_usage_ > max_disk_usage_)
+      pack_store_->Reclaim(current_disk_usage_ - max_disk_usage_);
+  }
   if (current_disk_usage_ > max_disk_usage_) {
     LOG(kError) << "current disk usage " << current_disk_usage_
                 << " is greater than max disk usage " << max_disk_usage_;
     BOOST_THROW_EXCEPTION(MakeError(CommonErrors::cannot_exceed_limit));
   }
+  if (kDurability_ == Durability::kGroupCommit) {
+    std::function<bool()> flush;
+    if (pack_store_)
+      flush = [this] { return pack_store_->Sync(); };
+    group_committer_.reset(new GroupCommitter(options.group_commit_window,
+                                              options.group_commit_size, flush));
+  }
+  if (options.compression && !kCompression_)
+    LOG(kWarning) << "Compression is unavailable for " << kDiskPath_ << " as it predates it.";
+  RegisterOpenRoot(kDiskPath_);
+  if (!pack_store_)
+    background_thread_ = std::thread([this] { RunBackgroundTasks(); });
 }
 
-ChunkStore::~ChunkStore() {}
+ChunkStore::~ChunkStore() {
+  // Queued asynchronous operations and the background migration can still change the usage, so
+  // both must finish before it's recorded.
+  io_threads_.reset();
+  stop_background_ = true;
+  if (background_thread_.joinable())
+    background_thread_.join();
+  // Its compaction thread reports freed space to this store.
+  const bool pack_file(static_cast<bool>(pack_store_));
+  pack_store_.reset();
+  try {
+    boost::system::error_code error_code;
+    // Only the last store open on the root may write the ledger, otherwise a store being replaced
+    // could record a stale usage.
+    if (UnregisterOpenRoot(kDiskPath_) && !pack_file && fs::is_directory(kDiskPath_, error_code))
+      WriteUsageLedger(kDiskPath_, current_disk_usage_);
+  } catch (const std::exception& e) {
+    LOG(kWarning) << "Failed to record usage ledger: " << boost::diagnostic_information(e);
+  }
+}
 
 void ChunkStore::Put(const NameType& name, const NonEmptyString& value) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  if (!fs::exists(kDiskPath_)) {
-    LOG(kError) << "ChunkStore::Put kDiskPath_ " << kDiskPath_ << " doesn't exists";
+  // Only the space accounting and the write itself are done while holding the stripe.
+  ++operation_count_;
+  ChunkStoreMetrics::Timer timer(metrics_, ChunkStoreMetrics::Operation::kPut);
+  timer.AddBytes(value.string().size());
+  auto chunk_key(ToChunkKey(name));
+  timer.Lap(ChunkStoreMetrics::Phase::kPathResolution);
+  boost::optional<NonEmptyString> content;
+  if (ImmutableChunkStored(chunk_key, name, value, content)) {
+    // For kGroupCommit, a concurrent Put of the same chunk may not have been committed yet.
+    CommitChunk(chunk_key);
+    timer.Lap(ChunkStoreMetrics::Phase::kDiskIo);
+    return;
+  }
+  if (!content)
+    content = EncodeChunk(name, value);
+  timer.Lap(ChunkStoreMetrics::Phase::kCrypto);
+  // For kGroupCommit, the staged content must be durable before it replaces the original.
+  auto staged_path(StageChunk(chunk_key, *content));
+  if (group_committer_ && !staged_path.empty() &&
+      !group_committer_->Sync(staged_path, fs::path())) {
+    DiscardStagedChunk(staged_path);
     BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
   }
+  timer.Lap(ChunkStoreMetrics::Phase::kDiskIo);
+  {
+    std::lock_guard<std::mutex> lock(Stripe(chunk_key));
+    timer.Lap(ChunkStoreMetrics::Phase::kLockWait);
+    try {
+      CheckDiskRoot();
+      DoPut(chunk_key, name, *content, staged_path);
+    } catch (...) {
+      DiscardStagedChunk(staged_path);
+      throw;
+    }
+    timer.Lap(ChunkStoreMetrics::Phase::kDiskIo);
+  }
+  CommitChunk(chunk_key);
+  timer.Lap(ChunkStoreMetrics::Phase::kDiskIo);
+}
 
-  const auto& name_str(name.name.string());
-  crypto::AES256KeyAndIV key_and_iv(std::vector<byte>(
-      name_str.begin(), name_str.begin() + crypto::AES256_KeySize + crypto::AES256_IVSize));
-  auto content(crypto::SymmEncrypt(value, key_and_iv));
-  auto file_path(NameToFilePath(name));
-  std::uint32_t value_size(static_cast<std::uint32_t>(content.data.string().size()));
-  std::uint64_t file_size(0), size(0);
-  bool increment(true);
+void ChunkStore::Delete(const NameType& name) {
+  ++operation_count_;
+  ChunkStoreMetrics::Timer timer(metrics_, ChunkStoreMetrics::Operation::kDelete);
+  auto chunk_key(ToChunkKey(name));
+  timer.Lap(ChunkStoreMetrics::Phase::kPathResolution);
+  {
+    std::lock_guard<std::mutex> lock(Stripe(chunk_key));
+    timer.Lap(ChunkStoreMetrics::Phase::kLockWait);
+    DoDelete(chunk_key);
+    timer.Lap(ChunkStoreMetrics::Phase::kDiskIo);
+  }
+  CommitChunk(chunk_key);
+  timer.Lap(ChunkStoreMetrics::Phase::kDiskIo);
+}
+
+NonEmptyString ChunkStore::Get(const NameType& name) const {
+  ++operation_count_;
+  ChunkStoreMetrics::Timer timer(metrics_, ChunkStoreMetrics::Operation::kGet);
+  auto chunk_key(ToChunkKey(name));
+  if (!MayBeStored(chunk_key))
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::no_such_element));
+  timer.Lap(ChunkStoreMetrics::Phase::kPathResolution);
+  const std::size_t stripe(StripeIndex(chunk_key));
+  boost::optional<std::vector<byte>> content;
+  std::uint64_t generation(0);
+  {
+    std::lock_guard<std::mutex> lock(stripes_[stripe]);
+    timer.Lap(ChunkStoreMetrics::Phase::kLockWait);
+    if (cache_) {
+      auto cached(cache_->Get(CacheKey(chunk_key.obfuscated_name)));
+      if (cached) {
+        timer.AddBytes(cached->string().size());
+        return *cached;
+      }
+    }
+    content = ReadChunk(chunk_key);
+    generation = generations_[stripe];
+    timer.Lap(ChunkStoreMetrics::Phase::kDiskIo);
+  }
+  if (!content)
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::no_such_element));
+  auto value(DecodeChunk(name, std::move(*content)));
+  timer.Lap(ChunkStoreMetrics::Phase::kCrypto);
+  timer.AddBytes(value.string().size());
+  CacheValue(chunk_key, generation, value);
+  return value;
+}
+
+std::vector<byte> ChunkStore::GetRange(const NameType& name, std::uint64_t offset,
+                                       std::uint64_t length) const {
+  ++operation_count_;
+  ChunkStoreMetrics::Timer timer(metrics_, ChunkStoreMetrics::Operation::kGetRange);
+  auto chunk_key(ToChunkKey(name));
+  if (!MayBeStored(chunk_key))
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::no_such_element));
+  timer.Lap(ChunkStoreMetrics::Phase::kPathResolution);
+  const std::size_t stripe(StripeIndex(chunk_key));
+  // Either the whole content, or for a segmented chunk, its header and the segments in the range.
+  boost::optional<std::vector<byte>> content;
+  boost::optional<SegmentTable> table;
+  std::uint64_t first_segment(0), end(0), generation(0);
+  {
+    std::lock_guard<std::mutex> lock(stripes_[stripe]);
+    timer.Lap(ChunkStoreMetrics::Phase::kLockWait);
+    if (cache_) {
+      auto cached(cache_->Get(CacheKey(chunk_key.obfuscated_name)));
+      if (cached) {
+        auto range(Slice(cached->string(), offset, length));
+        timer.AddBytes(range.size());
+        return range;
+      }
+    }
+    if (kLayout_.chunk_format != kRawChunkFormat) {
+      // Only the body is read, so the checksum in a chunk header isn't verified here.
+      const std::uint64_t body_offset(BodyOffset(kLayout_.chunk_format));
+      content = ReadChunkRange(chunk_key, body_offset, kSegmentHeaderSize);
+      if (content && content->size() == kSegmentHeaderSize && content->front() == kSegmentedFlag) {
+        try {
+          table = ParseSegmentHeader(*content);
+          content = ReadChunkRange(chunk_key, body_offset, table->HeaderSize());
+          if (!content || content->size() != table->HeaderSize())
+            BOOST_THROW_EXCEPTION(MakeError(CommonErrors::parsing_error));
+          table = ParseSegmentHeader(*content);
+          end = offset < table->value_size ? offset + std::min(length, table->value_size - offset)
+                                           : offset;
+          if (offset < end) {
+            first_segment = offset / table->segment_size;
+            const std::uint64_t last_segment((end - 1) / table->segment_size);
+            const std::uint64_t begin_offset(table->SegmentOffset(first_segment)),
+                end_offset(table->SegmentOffset(last_segment + 1));
+            content = ReadChunkRange(chunk_key, body_offset + begin_offset,
+                                     end_offset - begin_offset);
+            if (!content || content->size() != end_offset - begin_offset)
+              BOOST_THROW_EXCEPTION(MakeError(CommonErrors::parsing_error));
+          }
+        } catch (const maidsafe_error& error) {
+          LOG(kError) << "Failed to read segments of " << name.name << ": "
+                      << boost::diagnostic_information(error);
+          BOOST_THROW_EXCEPTION(MakeError(CommonErrors::no_such_element));
+        }
+      }
+    }
+    if (!table) {
+      content = ReadChunk(chunk_key);
+      generation = generations_[stripe];
+    }
+    timer.Lap(ChunkStoreMetrics::Phase::kDiskIo);
+  }
+  if (!content)
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::no_such_element));
+
+  if (!table) {
+    auto value(DecodeChunk(name, std::move(*content)));
+    timer.Lap(ChunkStoreMetrics::Phase::kCrypto);
+    CacheValue(chunk_key, generation, value);
+    auto range(Slice(value.string(), offset, length));
+    timer.AddBytes(range.size());
+    return range;
+  }
+  std::vector<byte> range;
+  if (offset >= end)
+    return range;
+  range.reserve(static_cast<std::size_t>(end - offset));
+  try {
+    std::size_t position(0);
+    for (std::uint64_t i(first_segment); i * table->segment_size < end; ++i) {
+      DecodeSegment(name, *table, i, &(*content)[position], offset, end, range);
+      position += table->cipher_sizes[i];
+    }
+  } catch (const std::exception& e) {
+    LOG(kError) << "Failed to decode " << name.name << ": " << boost::diagnostic_information(e);
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::no_such_element));
+  }
+  timer.Lap(ChunkStoreMetrics::Phase::kCrypto);
+  timer.AddBytes(range.size());
+  return range;
+}
+
+ChunkStore::Reader::Reader(const ChunkStore& chunk_store, NameType name)
+    : chunk_store_(chunk_store), kName_(std::move(name)), position_(0) {}
+
+std::vector<byte> ChunkStore::Reader::Read(std::size_t max_size) {
+  auto bytes(chunk_store_.GetRange(kName_, position_, max_size));
+  position_ += bytes.size();
+  return bytes;
+}
+
+bool ChunkStore::Has(const NameType& name) const {
+  ++operation_count_;
+  auto chunk_key(ToChunkKey(name));
+  if (pack_store_)
+    return static_cast<bool>(pack_store_->Size(chunk_key.obfuscated_name));
+  if (!MayBeStored(chunk_key))
+    return false;
+  std::lock_guard<std::mutex> lock(Stripe(chunk_key));
   boost::system::error_code error_code;
+  return fs::exists(ExistingFilePath(chunk_key), error_code);
+}
 
-  if (fs::exists(file_path, error_code)) {
-    if (error_code) {
-      LOG(kError) << "Unable to determine file status for " << file_path << ": "
-                  << error_code.message();
-      BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+std::vector<maidsafe_error> ChunkStore::PutMany(
+    const std::vector<std::pair<NameType, NonEmptyString>>& chunks, bool sync) {
+  operation_count_ += chunks.size();
+  ChunkStoreMetrics::Timer timer(metrics_, ChunkStoreMetrics::Operation::kPutMany,
+                                 chunks.size());
+  std::vector<NameType> names;
+  names.reserve(chunks.size());
+  for (const auto& chunk : chunks) {
+    names.push_back(chunk.first);
+    timer.AddBytes(chunk.second.string().size());
+  }
+  auto chunk_keys(ToSortedChunkKeys(names));
+  timer.Lap(ChunkStoreMetrics::Phase::kPathResolution);
+  std::vector<const ChunkKey*> keys_by_index(chunks.size(), nullptr);
+  for (const auto& chunk_key : chunk_keys)
+    keys_by_index[chunk_key.first] = &chunk_key.second;
+  sync = sync || kDurability_ == Durability::kGroupCommit;
+  std::vector<maidsafe_error> results(chunks.size(), MakeError(CommonErrors::success));
+  std::vector<boost::optional<NonEmptyString>> contents(chunks.size());
+  std::vector<fs::path> staged_paths(chunks.size());
+  IoThreads().ParallelFor(chunks.size(), [&](std::size_t i) {
+    results[i] = RunForError([&] {
+      // Clearing 'contents[i]' marks the item as already stored.  It's still synced with the batch
+      // if need be, as a concurrent Put of it may not have been committed yet.
+      if (ImmutableChunkStored(*keys_by_index[i], chunks[i].first, chunks[i].second,
+                               contents[i])) {
+        contents[i] = boost::none;
+        return;
+      }
+      if (!contents[i])
+        contents[i] = EncodeChunk(chunks[i].first, chunks[i].second);
+      staged_paths[i] = StageChunk(*keys_by_index[i], *contents[i]);
+      // The batch is its own group, so staged content is synced directly.
+      if (sync && !staged_paths[i].empty() && !SyncFile(staged_paths[i]))
+        BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+    });
+  });
+  timer.Lap(ChunkStoreMetrics::Phase::kCrypto);
+
+  const auto success(make_error_code(CommonErrors::success));
+  {
+    auto locks(LockStripes(chunk_keys));
+    timer.Lap(ChunkStoreMetrics::Phase::kLockWait);
+    const maidsafe_error root_error(RunForError([&] { CheckDiskRoot(); }));
+    for (const auto& chunk_key : chunk_keys) {
+      const std::size_t i(chunk_key.first);
+      if (root_error.code() != success && results[i].code() == success)
+        results[i] = root_error;
+      if (results[i].code() == success && contents[i]) {
+        results[i] = RunForError(
+            [&] { DoPut(chunk_key.second, names[i], *contents[i], staged_paths[i]); });
+      }
+      if (results[i].code() != success)
+        DiscardStagedChunk(staged_paths[i]);
     }
-    file_size = fs::file_size(file_path, error_code);
-    if (error_code) {
-      LOG(kError) << "Error getting file size of " << file_path << ": " << error_code.message();
-      BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+    timer.Lap(ChunkStoreMetrics::Phase::kDiskIo);
+  }
+
+  // Staged chunks only need their directories syncing.
+  if (sync) {
+    SyncBatch(chunk_keys, kDurability_ == Durability::kBuffered, results);
+    timer.Lap(ChunkStoreMetrics::Phase::kDiskIo);
+  }
+  return results;
+}
+
+std::vector<ChunkStore::GetResult> ChunkStore::GetMany(const std::vector<NameType>& names) const {
+  operation_count_ += names.size();
+  ChunkStoreMetrics::Timer timer(metrics_, ChunkStoreMetrics::Operation::kGetMany,
+                                 names.size());
+  auto chunk_keys(ToSortedChunkKeys(names));
+  timer.Lap(ChunkStoreMetrics::Phase::kPathResolution);
+  std::vector<GetResult> results(names.size(),
+                                 boost::make_unexpected(MakeError(CommonErrors::no_such_element)));
+  std::vector<boost::optional<std::vector<byte>>> contents(names.size());
+  std::vector<std::uint64_t> generations(names.size(), 0);
+  // Indexed by position in 'names', for use once the locks are released.
+  std::vector<const ChunkKey*> keys_by_index(names.size(), nullptr);
+  for (const auto& chunk_key : chunk_keys)
+    keys_by_index[chunk_key.first] = &chunk_key.second;
+  {
+    auto locks(LockStripes(chunk_keys));
+    timer.Lap(ChunkStoreMetrics::Phase::kLockWait);
+    for (const auto& chunk_key : chunk_keys) {
+      const std::size_t i(chunk_key.first);
+      if (cache_) {
+        auto cached(cache_->Get(CacheKey(chunk_key.second.obfuscated_name)));
+        if (cached) {
+          results[i] = GetResult(std::move(*cached));
+          continue;
+        }
+      }
+      maidsafe_error error(RunForError([&] { contents[i] = ReadChunk(chunk_key.second); }));
+      if (error.code() != make_error_code(CommonErrors::success))
+        results[i] = boost::make_unexpected(error);
+      generations[i] = generations_[StripeIndex(chunk_key.second)];
     }
+    timer.Lap(ChunkStoreMetrics::Phase::kDiskIo);
   }
-  if (file_size != 0) {
-    if (file_size <= value_size) {
-      size = value_size - file_size;
+
+  // Decryption happens after every stripe has been released.
+  IoThreads().ParallelFor(names.size(), [&](std::size_t i) {
+    if (!contents[i])
+      return;
+    NonEmptyString value;
+    maidsafe_error error(
+        RunForError([&] { value = DecodeChunk(names[i], std::move(*contents[i])); }));
+    if (error.code() == make_error_code(CommonErrors::success)) {
+      CacheValue(*keys_by_index[i], generations[i], value);
+      results[i] = GetResult(std::move(value));
     } else {
-      size = file_size - value_size;
+      results[i] = boost::make_unexpected(error);
+    }
+  });
+  timer.Lap(ChunkStoreMetrics::Phase::kCrypto);
+  for (const auto& result : results) {
+    if (result)
+      timer.AddBytes(result->string().size());
+  }
+  return results;
+}
+
+std::vector<maidsafe_error> ChunkStore::DeleteMany(const std::vector<NameType>& names,
+                                                   bool sync) {
+  operation_count_ += names.size();
+  ChunkStoreMetrics::Timer timer(metrics_, ChunkStoreMetrics::Operation::kDeleteMany,
+                                 names.size());
+  auto chunk_keys(ToSortedChunkKeys(names));
+  timer.Lap(ChunkStoreMetrics::Phase::kPathResolution);
+  std::vector<maidsafe_error> results(names.size(), MakeError(CommonErrors::success));
+  {
+    auto locks(LockStripes(chunk_keys));
+    timer.Lap(ChunkStoreMetrics::Phase::kLockWait);
+    for (const auto& chunk_key : chunk_keys) {
+      results[chunk_key.first] =
+          RunForError([&] { DoDelete(chunk_key.second); });
+    }
+    timer.Lap(ChunkStoreMetrics::Phase::kDiskIo);
+  }
+
+  if (sync || kDurability_ == Durability::kGroupCommit) {
+    SyncBatch(chunk_keys, false, results);
+    timer.Lap(ChunkStoreMetrics::Phase::kDiskIo);
+  }
+  return results;
+}
+
+void ChunkStore::DoPut(const ChunkKey& chunk_key, const NameType& name,
+                       const NonEmptyString& content, const fs::path& staged_path) {
+  ++generations_[StripeIndex(chunk_key)];
+  if (cache_)
+    cache_->Erase(CacheKey(chunk_key.obfuscated_name));
+
+  std::uint32_t value_size(static_cast<std::uint32_t>(content.string().size()));
+  std::uint64_t stored_size(StoredSize(chunk_key)), size(0);
+  bool increment(true);
+  // While migrating, a stale legacy copy shadowed by the chunk's current file is counted apart from
+  // 'stored_size'.
+  boost::system::error_code error_code;
+  const std::uint64_t shadowed_size(
+      !chunk_key.legacy_file_path.empty() && fs::exists(chunk_key.file_path, error_code) ?
+          ExistingFileSize(chunk_key.legacy_file_path) : 0);
+
+  if (pack_store_) {
+    // A replaced record stays on disk until compaction, which reports the space it frees.
+    size = PackStore::SpaceRequired(chunk_key.obfuscated_name, value_size);
+  } else if (stored_size != 0) {
+    if (stored_size <= value_size) {
+      size = value_size - stored_size;
+    } else {
+      size = stored_size - value_size;
       increment = false;
     }
   } else {
     size = value_size;
   }
 
-  if (increment) {
-    if (!HasDiskSpace(size)) {
-      LOG(kError) << "Cannot store " << name.name << " since the addition of " << size
-                  << " bytes exceeds max of " << max_disk_usage_ << " bytes.";
-      BOOST_THROW_EXCEPTION(MakeError(CommonErrors::cannot_exceed_limit));
-    }
+  // The pack file's dead records count against the max until compacted, so compact some now
+  // rather than refuse.
+  if (increment && !ReserveDiskSpace(size) &&
+      !(pack_store_ && pack_store_->Reclaim(size) != 0 && ReserveDiskSpace(size))) {
+    LOG(kError) << "Cannot store " << name.name << " since the addition of " << size
+                << " bytes exceeds max of " << max_disk_usage_ << " bytes.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::cannot_exceed_limit));
   }
-  if (!WriteFile(file_path, content.data.string())) {
+  if (!WriteChunk(chunk_key, content.string(), staged_path)) {
     LOG(kError) << "Failed to write " << name.name << " to disk.";
+    if (increment)
+      ReleaseDiskSpace(size);
     BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
   }
 
-  if (increment) {
-    current_disk_usage_.data += size;
+  if (!increment)
+    ReleaseDiskSpace(size);
+  if (!chunk_key.legacy_file_path.empty())
+    RemoveLegacyCopy(chunk_key, shadowed_size);
+  if (existence_filter_ && stored_size == 0)
+    existence_filter_->Add(chunk_key.obfuscated_name.name.string(),
+                           chunk_key.obfuscated_name.type_id.data);
+}
+
+NonEmptyString ChunkStore::EncodeChunk(const NameType& name, const NonEmptyString& value) const {
+  if (kLayout_.chunk_format == kRawChunkFormat)
+    return crypto::SymmEncrypt(value, ChunkKeyAndIV(name)).data;
+  // The body is written after space for the header, if any.
+  const std::size_t body_offset(BodyOffset(kLayout_.chunk_format));
+  std::vector<byte> content(body_offset);
+  auto compressed(kCompression_ ? Compress(value) : boost::none);
+  if (!compressed && kSegmentSize_ != 0 && value.string().size() > kSegmentSize_) {
+    EncodeSegments(name, value.string(), kSegmentSize_, content);
   } else {
-    current_disk_usage_.data -= size;
+    auto cipher_text(crypto::SymmEncrypt(compressed ? *compressed : value, ChunkKeyAndIV(name)));
+    const auto& cipher_bytes(cipher_text.data.string());
+    content.reserve(body_offset + cipher_bytes.size() + 1);
+    content.push_back(compressed ? kCompressedFlag : 0);
+    content.insert(std::end(content), std::begin(cipher_bytes), std::end(cipher_bytes));
   }
+  if (body_offset != 0)
+    WriteChunkHeader(value.string().size(), content);
+  return NonEmptyString(std::move(content));
 }
 
-void ChunkStore::Delete(const NameType& name) {
-  std::lock_guard<std::mutex> lock(mutex_);
-  auto path(NameToFilePath(name));
-  boost::system::error_code error_code;
-  std::uint64_t file_size(fs::file_size(path, error_code));
-  if (error_code) {
-    LOG(kError) << "Error getting file size of " << path << ": " << error_code.message();
-    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+NonEmptyString ChunkStore::DecodeChunk(const NameType& name, std::vector<byte>&& content) const {
+  try {
+    byte flags(0);
+    if (kLayout_.chunk_format != kRawChunkFormat) {
+      // Corruption is caught here by the checksum, if the chunk has a header, before decrypting.
+      CheckStoredContent(content, kLayout_.chunk_format);
+      const std::size_t body_offset(BodyOffset(kLayout_.chunk_format));
+      if (content[body_offset] == kSegmentedFlag) {
+        const auto table(
+            ParseSegmentHeader(&content[body_offset], content.size() - body_offset));
+        std::vector<byte> value;
+        value.reserve(static_cast<std::size_t>(table.value_size));
+        std::uint64_t offset(body_offset + table.HeaderSize());
+        for (std::size_t i(0); i != table.cipher_sizes.size(); ++i) {
+          DecodeSegment(name, table, i, &content[offset], 0, table.value_size, value);
+          offset += table.cipher_sizes[i];
+        }
+        return NonEmptyString(std::move(value));
+      }
+      flags = content[body_offset];
+      content.erase(std::begin(content), std::begin(content) + body_offset + 1);
+    }
+    // The read buffer is handed straight to the cipher rather than copied.
+    auto value(crypto::SymmDecrypt(crypto::CipherText(NonEmptyString(std::move(content))),
+                                   ChunkKeyAndIV(name)));
+    if ((flags & kCompressedFlag) != 0)
+      return crypto::Uncompress(crypto::CompressedText(std::move(value)));
+    return value;
+  } catch (const std::exception& e) {
+    LOG(kError) << "Failed to decode " << name.name << ": " << boost::diagnostic_information(e);
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::no_such_element));
   }
-  if (!fs::remove(path, error_code) || error_code) {
-    LOG(kError) << "Error removing " << path << ": " << error_code.message();
-    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+}
+
+void ChunkStore::DoDelete(const ChunkKey& chunk_key) {
+  ++generations_[StripeIndex(chunk_key)];
+  if (cache_)
+    cache_->Erase(CacheKey(chunk_key.obfuscated_name));
+  const std::uint64_t removed_size(RemoveChunk(chunk_key));
+  // Deleting from the pack file appends a tombstone, and the record's space is freed by compaction.
+  // Deletes are never refused, so this may briefly take the usage over the max.
+  if (pack_store_)
+    current_disk_usage_ += PackStore::SpaceRequired(chunk_key.obfuscated_name, 0);
+  else
+    ReleaseDiskSpace(removed_size);
+  // Until the filter is built, the chunk may not have been counted yet.  Skipping the removal can
+  // only leave a false positive.
+  if (existence_filter_ready_)
+    existence_filter_->Remove(chunk_key.obfuscated_name.name.string(),
+                              chunk_key.obfuscated_name.type_id.data);
+}
+
+bool ChunkStore::MayBeStored(const ChunkKey& chunk_key) const {
+  return !existence_filter_ready_ ||
+         existence_filter_->MayContain(chunk_key.obfuscated_name.name.string(),
+                                       chunk_key.obfuscated_name.type_id.data);
+}
+
+bool ChunkStore::ImmutableChunkStored(const ChunkKey& chunk_key, const NameType& name,
+                                      const NonEmptyString& value,
+                                      boost::optional<NonEmptyString>& content) {
+  if (name.type_id != detail::TypeId<ImmutableData>::value || !MayBeStored(chunk_key))
+    return false;
+  // Concurrent Puts of the same new chunk may all miss this and write it, which is harmless.  A
+  // stored copy which doesn't match, say because it's truncated or corrupt, is replaced.
+  if (kLayout_.chunk_format == kHeaderedChunkFormat) {
+    // ImmutableData is named by its content, so a stored copy which matches its checksum and holds
+    // a value of the same size needn't be compared against a fresh encoding.
+    std::lock_guard<std::mutex> lock(Stripe(chunk_key));
+    auto stored_content(ReadChunk(chunk_key));
+    if (!stored_content || !ChunkHeaderMatches(*stored_content) ||
+        ReadInteger(&(*stored_content)[4], 8) != value.string().size()) {
+      return false;
+    }
+  } else {
+    // Without a checksum, the stored copy must be identical to the deterministic encoding.
+    // Checking the size first avoids reading a copy which can't match.
+    content = EncodeChunk(name, value);
+    std::lock_guard<std::mutex> lock(Stripe(chunk_key));
+    if (StoredSize(chunk_key) != content->string().size())
+      return false;
+    auto stored_content(ReadChunk(chunk_key));
+    if (!stored_content || *stored_content != content->string())
+      return false;
   }
-  current_disk_usage_.data -= file_size;
+  ++avoided_writes_;
+  return true;
 }
 
-NonEmptyString ChunkStore::Get(const NameType& name) const {
-  std::lock_guard<std::mutex> lock(mutex_);
-  auto content(ReadFile(NameToFilePath(name)));
+void ChunkStore::CacheValue(const ChunkKey& chunk_key, std::uint64_t generation,
+                            const NonEmptyString& value) const {
+  if (!cache_)
+    return;
+  const std::size_t stripe(StripeIndex(chunk_key));
+  std::lock_guard<std::mutex> lock(stripes_[stripe]);
+  // A Put or Delete on this stripe since the value was read may have superseded it.
+  if (generations_[stripe] == generation)
+    cache_->Put(CacheKey(chunk_key.obfuscated_name), value);
+}
+
+void ChunkStore::AsyncPut(const NameType& name, const NonEmptyString& value,
+                          std::function<void(maidsafe_error)> handler) {
+  IoThreads().Post([=] { handler(RunForError([&] { Put(name, value); })); });
+}
+
+void ChunkStore::AsyncDelete(const NameType& name, std::function<void(maidsafe_error)> handler) {
+  IoThreads().Post([=] { handler(RunForError([&] { Delete(name); })); });
+}
+
+void ChunkStore::AsyncGet(const NameType& name, std::function<void(GetResult)> handler) const {
+  IoThreads().Post([=] {
+    NonEmptyString value;
+    maidsafe_error error(RunForError([&] { value = Get(name); }));
+    if (error.code() == make_error_code(CommonErrors::success))
+      handler(GetResult(std::move(value)));
+    else
+      handler(boost::make_unexpected(error));
+  });
+}
+
+bool ChunkStore::LayoutMigrationPending() const { return migrating_; }
+
+bool ChunkStore::ExistenceFilterReady() const { return existence_filter_ready_; }
+
+std::uint64_t ChunkStore::VerifyStoredChunk(const NameType& obfuscated_name) const {
+  auto chunk_key(ObfuscatedChunkKey(obfuscated_name));
+  boost::optional<std::vector<byte>> content;
+  {
+    std::lock_guard<std::mutex> lock(Stripe(chunk_key));
+    content = ReadChunk(chunk_key);
+  }
   if (!content)
     BOOST_THROW_EXCEPTION(MakeError(CommonErrors::no_such_element));
   try {
-    const auto& name_str(name.name.string());
-    crypto::AES256KeyAndIV key_and_iv(std::vector<byte>(
-        name_str.begin(), name_str.begin() + crypto::AES256_KeySize + crypto::AES256_IVSize));
-    return crypto::SymmDecrypt(crypto::CipherText(NonEmptyString(*content)), key_and_iv);
-  } catch (const std::exception&) {
-    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::no_such_element));
+    CheckStoredContent(*content, kLayout_.chunk_format);
+  } catch (const maidsafe_error&) {
+    LOG(kError) << "Stored content of " << obfuscated_name.name << " is malformed.";
+    throw;
   }
+  return content->size();
+}
+
+bool ChunkStore::StoredChunksChecksummed() const {
+  return kLayout_.chunk_format == kHeaderedChunkFormat;
 }
 
+bool ChunkStore::DeleteCorruptChunk(const NameType& obfuscated_name) {
+  auto chunk_key(ObfuscatedChunkKey(obfuscated_name));
+  {
+    std::lock_guard<std::mutex> lock(Stripe(chunk_key));
+    // Checked again while holding the stripe, since a Put may have replaced the chunk since it was
+    // found to be corrupt.
+    auto content(ReadChunk(chunk_key));
+    if (!content)
+      return false;
+    try {
+      CheckStoredContent(*content, kLayout_.chunk_format);
+      return false;
+    } catch (const maidsafe_error& error) {
+      if (error.code() != make_error_code(CommonErrors::parsing_error))
+        throw;
+    }
+    LOG(kWarning) << "Deleting corrupt chunk " << obfuscated_name.name;
+    DoDelete(chunk_key);
+  }
+  CommitChunk(chunk_key);
+  return true;
+}
+
+std::uint64_t ChunkStore::CacheHits() const { return cache_ ? cache_->Hits() : 0; }
+
+std::uint64_t ChunkStore::CacheMisses() const { return cache_ ? cache_->Misses() : 0; }
+
 void ChunkStore::SetMaxDiskUsage(DiskUsage max_disk_usage) {
-  if (current_disk_usage_ > max_disk_usage) {
-    LOG(kError) << "current_disk_usage_ " << current_disk_usage_.data
+  if (current_disk_usage_ > max_disk_usage.data) {
+    LOG(kError) << "current_disk_usage_ " << current_disk_usage_
                 << " exceeds target max_disk_usage " << max_disk_usage.data;
     BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_argument));
   }
-  max_disk_usage_ = max_disk_usage;
+  max_disk_usage_ = max_disk_usage.data;
 }
 
 std::vector<ChunkStore::NameType> ChunkStore::Names() const {
   std::vector<NameType> names;
-  fs::directory_iterator end_iter;
+  std::mutex names_mutex;
+  ForEachName(NameFilter(), [&](const NameType& name) {
+    std::lock_guard<std::mutex> lock(names_mutex);
+    names.push_back(name);
+  });
+  return names;
+}
+
+void ChunkStore::ForEachName(const NameFilter& filter,
+                             const std::function<void(const NameType&)>& visitor) const {
+  if (pack_store_) {
+    // Listed a page at a time, so that 'visitor' isn't called holding the pack store's lock.
+    const std::size_t kPageSize(1024);
+    NamesPage page;
+    do {
+      page = GetNamesPage(filter, kPageSize, page.resume_after);
+      for (const auto& name : page.names)
+        visitor(name);
+    } while (page.resume_after);
+    return;
+  }
+
+  NameWalker walker(filter, boost::none);
+
+  boost::system::error_code error_code;
+  if (!fs::is_directory(kDiskPath_, error_code))
+    return;
+  auto top_level(walker.Walk(kDiskPath_, std::string(), false, [&](const NameType& name) {
+    visitor(name);
+    return true;
+  }));
+  IoThreads().ParallelFor(top_level.size(), [&](std::size_t i) {
+    walker.Walk(top_level[i].first, top_level[i].second, true, [&](const NameType& name) {
+      visitor(name);
+      return true;
+    });
+  });
+}
+
+ChunkStore::NamesPage ChunkStore::GetNamesPage(
+    const NameFilter& filter, std::size_t max_count,
+    const boost::optional<NameType>& resume_after) const {
+  NamesPage page;
+  if (max_count == 0)
+    return page;
+  NameWalker walker(filter, resume_after);
+  auto collect([&](const NameType& name) {
+    page.names.push_back(name);
+    return page.names.size() < max_count;
+  });
+
+  if (pack_store_) {
+    // The index is ordered, so the page starts from a lookup rather than a scan.
+    boost::optional<NameType> first(resume_after);
+    if (filter.first && (!first || first->name.string() < filter.first->string()))
+      first = NameType(*filter.first, DataTypeId(0));
+    pack_store_->VisitNames(first, [&](const NameType& name) {
+      return !walker.Beyond(name) && (!walker.Accepts(name) || collect(name));
+    });
+  } else {
+    boost::system::error_code error_code;
+    if (fs::is_directory(kDiskPath_, error_code))
+      walker.WalkInOrder(kDiskPath_, std::string(), collect);
+  }
+  if (page.names.size() == max_count)
+    page.resume_after = page.names.back();
+  return page;
+}
+
+std::size_t ChunkStore::StripeIndex(const ChunkKey& chunk_key) const {
+  // Stripes are chosen by the obfuscated name, which is all that is known when migrating chunks
+  // found on disk.  Being a hash, its leading bytes are uniformly distributed.
+  const auto& name_bytes(chunk_key.obfuscated_name.name.string());
+  std::size_t index((static_cast<std::size_t>(name_bytes[0]) << 8) | name_bytes[1]);
+  return (index ^ chunk_key.obfuscated_name.type_id.data) % kStripeCount_;
+}
 
-  if (fs::exists(kDiskPath_) && fs::is_directory(kDiskPath_)) {
-    for (fs::directory_iterator dir_iter(kDiskPath_); dir_iter != end_iter; ++dir_iter) {
-      if (fs::is_regular_file(dir_iter->status()))
-        names.push_back(detail::GetDataNameAndTypeId(*dir_iter));
-      else
-        GetNames(dir_iter->path(), dir_iter->path().filename().string(), names);
+std::mutex& ChunkStore::Stripe(const ChunkKey& chunk_key) const {
+  return stripes_[StripeIndex(chunk_key)];
+}
+
+std::vector<std::unique_lock<std::mutex>> ChunkStore::LockStripes(
+    const std::vector<std::pair<std::size_t, ChunkKey>>& chunk_keys) const {
+  std::set<std::size_t> indices;
+  for (const auto& chunk_key : chunk_keys)
+    indices.insert(StripeIndex(chunk_key.second));
+  // Always acquired in ascending order, so concurrent batches can't deadlock.
+  std::vector<std::unique_lock<std::mutex>> locks;
+  locks.reserve(indices.size());
+  for (auto index : indices)
+    locks.emplace_back(stripes_[index]);
+  return locks;
+}
+
+void ChunkStore::CheckDiskRoot() const {
+  if (!fs::exists(kDiskPath_)) {
+    LOG(kError) << "ChunkStore disk root " << kDiskPath_ << " doesn't exist";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+  }
+}
+
+bool ChunkStore::ReserveDiskSpace(std::uint64_t required_space) {
+  std::uint64_t current_usage(current_disk_usage_.load());
+  do {
+    if (current_usage + required_space > max_disk_usage_.load())
+      return false;
+  } while (!current_disk_usage_.compare_exchange_weak(current_usage,
+                                                      current_usage + required_space));
+  return true;
+}
+
+void ChunkStore::ReleaseDiskSpace(std::uint64_t space) {
+  current_disk_usage_ -= space;
+}
+
+ThreadPool& ChunkStore::IoThreads() const {
+  std::call_once(io_threads_flag_, [this] {
+    std::uint32_t thread_count(std::max(std::thread::hardware_concurrency(), 2U));
+    io_threads_.reset(new ThreadPool(std::min(thread_count, 8U)));
+  });
+  return *io_threads_;
+}
+
+std::vector<std::pair<std::size_t, ChunkStore::ChunkKey>> ChunkStore::ToSortedChunkKeys(
+    const std::vector<NameType>& names) const {
+  std::vector<std::pair<std::size_t, ChunkKey>> chunk_keys;
+  chunk_keys.reserve(names.size());
+  for (std::size_t i(0); i != names.size(); ++i)
+    chunk_keys.emplace_back(i, ToChunkKey(names[i]));
+  // The on-disk location of a chunk is derived from its obfuscated name in order, so sorting by
+  // name keeps each directory's entries together.  The sort is stable so that repeated names are
+  // still applied in the caller's order.
+  std::stable_sort(std::begin(chunk_keys), std::end(chunk_keys),
+                   [](const std::pair<std::size_t, ChunkKey>& lhs,
+                      const std::pair<std::size_t, ChunkKey>& rhs) {
+                     return lhs.second.obfuscated_name < rhs.second.obfuscated_name;
+                   });
+  return chunk_keys;
+}
+
+void ChunkStore::SyncBatch(const std::vector<std::pair<std::size_t, ChunkKey>>& chunk_keys,
+                           bool sync_files, std::vector<maidsafe_error>& results) const {
+  const auto success(make_error_code(CommonErrors::success));
+  if (pack_store_) {
+    if (!pack_store_->Sync()) {
+      for (auto& result : results) {
+        if (result.code() == success)
+          result = MakeError(CommonErrors::filesystem_io_error);
+      }
+    }
+    return;
+  }
+
+  std::set<fs::path> directories, failed_directories;
+  for (const auto& chunk_key : chunk_keys)
+    directories.insert(chunk_key.second.file_path.parent_path());
+  for (const auto& directory : directories) {
+    if (!SyncDirectory(directory))
+      failed_directories.insert(directory);
+  }
+  for (const auto& chunk_key : chunk_keys) {
+    auto& result(results[chunk_key.first]);
+    if (result.code() != success)
+      continue;
+    if ((sync_files && !SyncFile(chunk_key.second.file_path)) ||
+        failed_directories.count(chunk_key.second.file_path.parent_path()) != 0) {
+      result = MakeError(CommonErrors::filesystem_io_error);
     }
   }
-  return names;
 }
 
-void ChunkStore::GetNames(const boost::filesystem::path& path, std::string prefix,
-                          std::vector<NameType>& names) const {
-  fs::directory_iterator end_iter;
-  for (fs::directory_iterator dir_iter(path); dir_iter != end_iter; ++dir_iter) {
-    if (fs::is_regular_file(dir_iter->status()))
-      names.push_back(ComposeName(prefix + dir_iter->path().filename().string()));
+ChunkStore::Layout ChunkStore::InitialiseLayout(const fs::path& disk_root,
+                                                const Options& options,
+                                                const PackStore* pack_store) {
+  auto contents(ReadFile(ManifestPath(disk_root)));
+  if (contents) {
+    const std::string manifest(convert::ToString(*contents));
+    std::uint32_t version(0);
+    Layout layout{0, 0, false, kRawChunkFormat};
+    ConvertFromString(manifest, version);
+    if (version == 1) {
+      ConvertFromString(manifest, version, layout.width, layout.depth, layout.migrating);
+    } else if (version == kManifestVersion) {
+      ConvertFromString(manifest, version, layout.width, layout.depth, layout.migrating,
+                        layout.chunk_format);
+    } else {
+      LOG(kError) << "Unsupported manifest version " << version << " in " << disk_root;
+      BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_conversion));
+    }
+    return layout;
+  }
+
+  if (pack_store) {
+    // A pack store without a manifest may already hold chunks in the raw format.
+    Layout layout{0, 0, false,
+                  pack_store->LiveBytes() == 0 ? kHeaderedChunkFormat : kRawChunkFormat};
+    WriteManifest(disk_root, layout.width, layout.depth, layout.migrating, layout.chunk_format);
+    return layout;
+  }
+
+  if (options.directory_width < 2 || options.directory_depth == 0 ||
+      options.directory_width * options.directory_depth > kMaxDirectoryCharacters) {
+    LOG(kError) << "Invalid directory layout " << options.directory_width << " x "
+                << options.directory_depth;
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::invalid_argument));
+  }
+  // Anything already in a root without a manifest was stored using the original layout and chunk
+  // format.
+  bool migrating(false);
+  for (fs::directory_iterator itr(disk_root); itr != fs::directory_iterator(); ++itr) {
+    if (!IsMetadataFile(itr->path())) {
+      migrating = true;
+      break;
+    }
+  }
+  Layout layout{options.directory_width, options.directory_depth, migrating,
+                migrating ? kRawChunkFormat : kHeaderedChunkFormat};
+  PrecreateDirectories(disk_root, layout.width, layout.depth);
+  WriteManifest(disk_root, layout.width, layout.depth, layout.migrating, layout.chunk_format);
+  return layout;
+}
+
+void ChunkStore::RunBackgroundTasks() {
+  if (migrating_)
+    MigrateLegacyLayout();
+  BuildExistenceFilter();
+}
+
+void ChunkStore::MigrateLegacyLayout() {
+  bool complete(true);
+  try {
+    for (fs::directory_iterator itr(kDiskPath_); itr != fs::directory_iterator(); ++itr) {
+      // Legacy directories are the only ones with single character names.
+      const std::string name(itr->path().filename().string());
+      if (name.size() == kLegacyDirectoryWidth && fs::is_directory(itr->status()))
+        complete = MigrateLegacyDirectory(itr->path(), name) && complete;
+      if (stop_background_)
+        return;
+    }
+  } catch (const std::exception& e) {
+    LOG(kError) << "Failed migrating " << kDiskPath_ << ": " << boost::diagnostic_information(e);
+    complete = false;
+  }
+  if (!complete) {
+    LOG(kWarning) << "Migration of " << kDiskPath_ << " incomplete; will retry on next start.";
+    return;
+  }
+  try {
+    WriteManifest(kDiskPath_, kLayout_.width, kLayout_.depth, false, kLayout_.chunk_format);
+    migrating_ = false;
+    LOG(kInfo) << "Migrated " << kDiskPath_ << " to the current directory layout.";
+  } catch (const std::exception& e) {
+    LOG(kError) << "Failed updating manifest: " << boost::diagnostic_information(e);
+  }
+}
+
+bool ChunkStore::MigrateLegacyDirectory(const fs::path& directory, const std::string& prefix) {
+  bool complete(true);
+  std::vector<fs::path> children;
+  for (fs::directory_iterator itr(directory); itr != fs::directory_iterator(); ++itr)
+    children.push_back(itr->path());
+  for (const auto& child : children) {
+    if (stop_background_)
+      return false;
+    const std::string file_name(prefix + child.filename().string());
+    if (fs::is_directory(child))
+      complete = MigrateLegacyDirectory(child, file_name) && complete;
     else
-      GetNames(dir_iter->path(), prefix + dir_iter->path().filename().string(), names);
+      complete = MigrateLegacyChunk(child, file_name) && complete;
   }
+  boost::system::error_code error_code;
+  if (complete)
+    fs::remove(directory, error_code);
+  return complete;
 }
 
-ChunkStore::NameType ChunkStore::ComposeName(std::string file_name_str) const {
-  size_t index(file_name_str.rfind('_'));
-  auto type(static_cast<DataTypeId>(std::stoul(file_name_str.substr(index + 1))));
-  Identity id(hex::DecodeToBytes(file_name_str.substr(0, index)));
-  return NameType(id, type);
+bool ChunkStore::MigrateLegacyChunk(const fs::path& legacy_path, const std::string& file_name) {
+  auto obfuscated_name(ParseFileName(file_name));
+  if (!obfuscated_name) {
+    LOG(kWarning) << "Ignoring unrecognised file " << legacy_path;
+    return false;
+  }
+  const ChunkKey chunk_key{*obfuscated_name,
+                           ChunkPath(*obfuscated_name, kLayout_.width, kLayout_.depth),
+                           legacy_path};
+
+  std::lock_guard<std::mutex> lock(Stripe(chunk_key));
+  boost::system::error_code error_code;
+  if (!fs::exists(legacy_path, error_code))
+    return true;
+  if (fs::exists(chunk_key.file_path, error_code)) {
+    // The chunk has been rewritten in the new layout since, so the legacy copy is stale.  It was
+    // counted apart from the current file, and only stops being counted once it's removed.
+    std::uint64_t size(ExistingFileSize(legacy_path));
+    if (!fs::remove(legacy_path, error_code) || error_code)
+      return false;
+    ReleaseDiskSpace(size);
+    return true;
+  }
+  fs::rename(legacy_path, chunk_key.file_path, error_code);
+  if (error_code) {
+    LOG(kError) << "Failed to move " << legacy_path << " to " << chunk_key.file_path << ": "
+                << error_code.message();
+    return false;
+  }
+  return true;
 }
 
-bool ChunkStore::HasDiskSpace(std::uint64_t required_space) const {
-  return current_disk_usage_ + required_space <= max_disk_usage_;
+void ChunkStore::BuildExistenceFilter() {
+  // Chunks stored concurrently are added by DoPut as well as possibly by the walk.  Counting them
+  // twice is harmless, since a later removal then leaves a false positive rather than a false
+  // negative.
+  NameWalker walker(NameFilter(), boost::none);
+  auto add([this](const NameType& name) {
+    existence_filter_->Add(name.name.string(), name.type_id.data);
+    return !stop_background_;
+  });
+  try {
+    for (const auto& directory : walker.Walk(kDiskPath_, std::string(), false, add)) {
+      if (stop_background_)
+        return;
+      walker.Walk(directory.first, directory.second, true, add);
+    }
+  } catch (const std::exception& e) {
+    // Lookups carry on checking the disk.
+    LOG(kError) << "Failed building existence filter for " << kDiskPath_ << ": "
+                << boost::diagnostic_information(e);
+    return;
+  }
+  if (!stop_background_)
+    existence_filter_ready_ = true;
 }
 
-fs::path ChunkStore::NameToFilePath(NameType name) const {
+ChunkStore::ChunkKey ChunkStore::ToChunkKey(NameType name) const {
   name.name = crypto::Hash<crypto::SHA512>(name.name);
-  std::string file_name(detail::GetFileName(name).string());
+  return ObfuscatedChunkKey(std::move(name));
+}
 
-  std::uint32_t directory_depth = kDepth_;
-  if (file_name.size() < directory_depth)
-    directory_depth = static_cast<std::uint32_t>(file_name.size() - 1);
+ChunkStore::ChunkKey ChunkStore::ObfuscatedChunkKey(NameType obfuscated_name) const {
+  if (pack_store_)
+    return ChunkKey{std::move(obfuscated_name), fs::path(), fs::path()};
+  auto file_path(ChunkPath(obfuscated_name, kLayout_.width, kLayout_.depth));
+  fs::path legacy_file_path;
+  if (migrating_)
+    legacy_file_path = ChunkPath(obfuscated_name, kLegacyDirectoryWidth, kLegacyDirectoryDepth);
+  return ChunkKey{std::move(obfuscated_name), std::move(file_path), std::move(legacy_file_path)};
+}
 
+fs::path ChunkStore::ChunkPath(const NameType& obfuscated_name, std::uint32_t width,
+                               std::uint32_t depth) const {
+  const std::string file_name(detail::GetFileName(obfuscated_name).string());
   fs::path disk_path(kDiskPath_);
-  for (std::uint32_t i = 0; i < directory_depth; ++i)
-    disk_path /= file_name.substr(i, 1);
+  for (std::uint32_t i(0); i != depth; ++i)
+    disk_path /= file_name.substr(i * width, width);
+  return disk_path / file_name.substr(width * depth);
+}
+
+const fs::path& ChunkStore::ExistingFilePath(const ChunkKey& chunk_key) const {
+  boost::system::error_code error_code;
+  if (!chunk_key.legacy_file_path.empty() && !fs::exists(chunk_key.file_path, error_code))
+    return chunk_key.legacy_file_path;
+  return chunk_key.file_path;
+}
+
+std::uint64_t ChunkStore::StoredSize(const ChunkKey& chunk_key) const {
+  if (pack_store_)
+    return pack_store_->Size(chunk_key.obfuscated_name).value_or(0);
+  return ExistingFileSize(ExistingFilePath(chunk_key));
+}
+
+fs::path ChunkStore::StageChunk(const ChunkKey& chunk_key, const NonEmptyString& content) {
+  if (pack_store_ || kDurability_ == Durability::kBuffered)
+    return fs::path();
+  fs::path staged_path(chunk_key.file_path.string() + "." + std::to_string(++staged_count_) +
+                       kStagedExtension);
+  if (!WriteChunkFile(staged_path, content.string())) {
+    LOG(kError) << "Failed to write " << staged_path;
+    DiscardStagedChunk(staged_path);
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+  }
+  return staged_path;
+}
+
+void ChunkStore::CommitChunk(const ChunkKey& chunk_key) {
+  if (!group_committer_)
+    return;
+  // For the pack file backend, the committer flushes the pack store instead.
+  const fs::path directory(pack_store_ ? fs::path() : chunk_key.file_path.parent_path());
+  if (!group_committer_->Sync(fs::path(), directory)) {
+    LOG(kError) << "Failed to commit " << chunk_key.obfuscated_name.name;
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+  }
+}
+
+bool ChunkStore::WriteChunk(const ChunkKey& chunk_key, const std::vector<byte>& content,
+                            const fs::path& staged_path) {
+  if (!pack_store_) {
+    if (staged_path.empty()) {
+      if (!WriteChunkFile(chunk_key.file_path, content))
+        return false;
+    } else {
+      boost::system::error_code error_code;
+      fs::rename(staged_path, chunk_key.file_path, error_code);
+      if (error_code) {
+        LOG(kError) << "Failed to rename " << staged_path << ": " << error_code.message();
+        return false;
+      }
+    }
+    return true;
+  }
+  try {
+    pack_store_->Put(chunk_key.obfuscated_name, content);
+    return true;
+  } catch (const std::exception& e) {
+    LOG(kError) << "Failed to append to pack store: " << boost::diagnostic_information(e);
+    return false;
+  }
+}
 
-  boost::system::error_code ec;
-  fs::create_directories(disk_path, ec);
+bool ChunkStore::WriteChunkFile(const fs::path& path, const std::vector<byte>& content) const {
+  if (kDirectIoThreshold_ != 0 && content.size() >= kDirectIoThreshold_)
+    return WriteFileUncached(path, content);
+  return WriteFile(path, content);
+}
+
+boost::optional<std::vector<byte>> ChunkStore::ReadChunk(const ChunkKey& chunk_key) const {
+  if (pack_store_)
+    return pack_store_->Get(chunk_key.obfuscated_name);
+  const auto& path(ExistingFilePath(chunk_key));
+  if (kDirectIoThreshold_ != 0)
+    return ReadFileUncached(path, kDirectIoThreshold_);
+  auto content(ReadFile(path));
+  if (!content)
+    return boost::none;
+  return std::move(*content);
+}
 
-  return fs::path(disk_path / file_name.substr(directory_depth));
+boost::optional<std::vector<byte>> ChunkStore::ReadChunkRange(const ChunkKey& chunk_key,
+                                                              std::uint64_t offset,
+                                                              std::uint64_t length) const {
+  if (pack_store_)
+    return pack_store_->GetRange(chunk_key.obfuscated_name, offset, length);
+  const auto& path(ExistingFilePath(chunk_key));
+  std::ifstream file(path.string(), std::ios::binary);
+  if (!file)
+    return boost::none;
+  std::vector<byte> content(static_cast<std::size_t>(length));
+  if (file.seekg(offset))
+    file.read(reinterpret_cast<char*>(content.data()), length);
+  if (file.bad()) {
+    LOG(kError) << "Failed to read " << length << " bytes at " << offset << " in " << path;
+    return boost::none;
+  }
+  content.resize(static_cast<std::size_t>(file.gcount()));
+  return content;
+}
+
+std::uint64_t ChunkStore::RemoveChunk(const ChunkKey& chunk_key) {
+  if (pack_store_) {
+    auto removed_size(pack_store_->Delete(chunk_key.obfuscated_name));
+    if (!removed_size) {
+      LOG(kError) << "Error removing " << chunk_key.obfuscated_name.name << " from pack store";
+      BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+    }
+    return *removed_size;
+  }
+
+  // A stale legacy copy is removed first, so that it can't be migrated back into place once the
+  // current file is gone.
+  std::uint64_t removed_size(0);
+  boost::system::error_code error_code;
+  if (!chunk_key.legacy_file_path.empty() && fs::exists(chunk_key.file_path, error_code) &&
+      fs::exists(chunk_key.legacy_file_path, error_code)) {
+    removed_size = RemoveChunkFile(chunk_key.legacy_file_path);
+  }
+  return removed_size + RemoveChunkFile(ExistingFilePath(chunk_key));
+}
+
+void ChunkStore::RemoveLegacyCopy(const ChunkKey& chunk_key, std::uint64_t counted_size) {
+  // Every chunk file is counted until it's removed, as on startup, so a copy which can't be
+  // removed stays counted whether or not it was before.
+  const std::uint64_t size(ExistingFileSize(chunk_key.legacy_file_path));
+  boost::system::error_code error_code;
+  if (size != 0 && (!fs::remove(chunk_key.legacy_file_path, error_code) || error_code)) {
+    LOG(kWarning) << "Failed to remove superseded " << chunk_key.legacy_file_path << ": "
+                  << error_code.message();
+    current_disk_usage_ += size - counted_size;
+    return;
+  }
+  ReleaseDiskSpace(counted_size);
 }
 
 }  // namespace vault
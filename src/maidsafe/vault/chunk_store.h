@@ -19,17 +19,26 @@
 #ifndef MAIDSAFE_VAULT_CHUNK_STORE_H_
 #define MAIDSAFE_VAULT_CHUNK_STORE_H_
 
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <set>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include "boost/filesystem/path.hpp"
+#include "boost/optional/optional.hpp"
 
 #include "boost/expected/expected.hpp"
 #include "boost/variant.hpp"
 
+#include "maidsafe/common/crypto.h"
 #include "maidsafe/common/tagged_value.h"
 #include "maidsafe/common/types.h"
 #include "maidsafe/common/data_types/data.h"
@@ -37,6 +46,13 @@
 #include "maidsafe/common/data_types/mutable_data.h"
 #include "maidsafe/passport/types.h"
 
+#include "maidsafe/vault/bloom_filter.h"
+#include "maidsafe/vault/chunk_cache.h"
+#include "maidsafe/vault/chunk_store_metrics.h"
+#include "maidsafe/vault/group_committer.h"
+#include "maidsafe/vault/pack_store.h"
+#include "maidsafe/vault/thread_pool.h"
+
 
 namespace maidsafe {
 
@@ -46,35 +62,289 @@ class ChunkStore {
  public:
   using NameType = Data::NameAndTypeId;
 
-  ChunkStore(const boost::filesystem::path& disk_path, DiskUsage max_disk_usage);
+  // kFilePerChunk stores each chunk as its own file in a directory tree keyed by its name, while
+  // kPackFile appends chunks to large segment files (see PackStore).  For kPackFile the disk usage
+  // is the size of those files, so a replaced or deleted chunk's space only becomes free once its
+  // segment is compacted, which a Put that would otherwise exceed the max triggers.
+  enum class Backend { kFilePerChunk, kPackFile };
+
+  // How far a Put or Delete has been made crash safe when it returns.  kBuffered writes chunk files
+  // in place and leaves flushing to the OS.  kAtomic writes each chunk to a temporary file which
+  // is renamed over the original, so a crash leaves either the old or the new content (appends to
+  // the pack file are always atomic).  kGroupCommit additionally makes every change durable
+  // before it is acknowledged, syncing the changes of concurrent callers together (see
+  // GroupCommitter).
+  enum class Durability { kBuffered, kAtomic, kGroupCommit };
+
+  struct Options {
+    Options();
+    Backend backend;
+    // A non-zero value enables an in-memory cache of up to this many bytes of decrypted chunk
+    // values (see ChunkCache).
+    std::uint64_t cache_capacity;
+    // The file-per-chunk backend spreads chunks over 'directory_depth' levels of directories, each
+    // named by 'directory_width' hex characters of the obfuscated name.  Every directory is created
+    // when the store is first initialised and the layout is recorded in the root's manifest, which
+    // takes precedence over these values when reopening an existing store.
+    std::uint32_t directory_width, directory_depth;
+    // Chunks which look compressible are compressed before being encrypted.  Only available to
+    // stores created by this version, as older ones don't flag each chunk's encoding.
+    bool compression;
+    // Values larger than this which aren't compressed are encrypted in segments of this size, so
+    // that part of one can be read without decrypting the rest (see GetRange).  Zero disables
+    // this, as does a store which predates compression.
+    std::uint32_t segment_size;
+    // The file-per-chunk backend reads and writes chunks of at least this size bypassing the OS
+    // page cache (see direct_io.h), so that bulk transfers don't evict the pages of smaller, hotter
+    // chunks or of databases on the same host.  Zero disables this.
+    std::uint64_t direct_io_threshold;
+    Durability durability;
+    // For kGroupCommit, a group is synced once it has been collecting changes for this long or
+    // holds this many.
+    std::chrono::milliseconds group_commit_window;
+    std::size_t group_commit_size;
+  };
+
+  ChunkStore(const boost::filesystem::path& disk_path, DiskUsage max_disk_usage,
+             Options options = Options());
   ~ChunkStore();
   ChunkStore(const ChunkStore&) = delete;
   ChunkStore(ChunkStore&&) = delete;
   ChunkStore& operator=(const ChunkStore&) = delete;
   ChunkStore& operator=(ChunkStore&&) = delete;
 
+  // ImmutableData is content-addressed, so storing a name and type which is already held intact is
+  // acknowledged without being written (see AvoidedWrites).
   void Put(const NameType& name, const NonEmptyString& value);
   void Delete(const NameType& name);
   NonEmptyString Get(const NameType& name) const;
+  // Returns up to 'length' bytes of the value from 'offset', fewer if it ends sooner.  Only the
+  // segments covering the range are read and decrypted; values which aren't stored in segments
+  // are decoded in full.
+  std::vector<byte> GetRange(const NameType& name, std::uint64_t offset,
+                             std::uint64_t length) const;
+  // Cheaper than Get, and for the file-per-chunk backend, names which aren't stored are usually
+  // rejected without touching the disk (see ExistenceFilterReady).
+  bool Has(const NameType& name) const;
+
+  // Reads a value front to back through GetRange, so that only the part being returned is held in
+  // memory.  If the value is replaced part way through, later reads come from the new version.
+  class Reader {
+   public:
+    Reader(const ChunkStore& chunk_store, NameType name);
+    // Returns up to 'max_size' of the following bytes, or nothing once the end has been reached.
+    std::vector<byte> Read(std::size_t max_size);
+    std::uint64_t Position() const { return position_; }
+
+   private:
+    const ChunkStore& chunk_store_;
+    const NameType kName_;
+    std::uint64_t position_;
+  };
+
+  // Asynchronous variants of the above.  Each operation runs on the store's I/O threads (created on
+  // first use) and its outcome is passed to 'handler' on that thread, so the handler must not
+  // block.  Errors are reported exactly as the synchronous versions would throw them.  Operations
+  // still queued when the store is destroyed are completed first.
+  using GetResult = boost::expected<NonEmptyString, maidsafe_error>;
+  void AsyncPut(const NameType& name, const NonEmptyString& value,
+                std::function<void(maidsafe_error)> handler);
+  void AsyncDelete(const NameType& name, std::function<void(maidsafe_error)> handler);
+  void AsyncGet(const NameType& name, std::function<void(GetResult)> handler) const;
+
+  // Batch variants of the above for bulk transfers.  The stripes covering the whole batch are
+  // locked once and the chunks are processed in on-disk order; results are returned per item in
+  // the order given.  If 'sync' is true (implied by kGroupCommit), the batch's changes are flushed
+  // to stable storage before returning, and any item which couldn't be made durable reports
+  // filesystem_io_error.
+  std::vector<maidsafe_error> PutMany(
+      const std::vector<std::pair<NameType, NonEmptyString>>& chunks, bool sync = false);
+  std::vector<GetResult> GetMany(const std::vector<NameType>& names) const;
+  std::vector<maidsafe_error> DeleteMany(const std::vector<NameType>& names, bool sync = false);
 
   void SetMaxDiskUsage(DiskUsage max_disk_usage);
 
-  DiskUsage MaxDiskUsage() const { return max_disk_usage_; }
-  DiskUsage CurrentDiskUsage() const { return current_disk_usage_; }
+  // True while chunks stored using the original directory layout are being moved in the
+  // background.  They remain accessible throughout.
+  bool LayoutMigrationPending() const;
+  // The file-per-chunk backend tracks stored names in a counting Bloom filter, populated in the
+  // background from the chunks found on disk.  Until this returns true, Has and Get for a missing
+  // name always check the disk.
+  bool ExistenceFilterReady() const;
+
+  // Checks the stored form of the chunk with the given obfuscated name (as reported by the
+  // enumeration functions below) without decoding it, and returns the number of bytes read.  Stores
+  // created since chunks were given headers also verify the chunk's checksum.  Throws
+  // no_such_element if it's no longer stored, or parsing_error if it's malformed or corrupt.
+  std::uint64_t VerifyStoredChunk(const NameType& obfuscated_name) const;
+  // False if stored chunks have no checksums, as in stores migrated from the original layout, in
+  // which case the above can only find chunks which are malformed, not ones which are corrupt.
+  bool StoredChunksChecksummed() const;
+  // Deletes the chunk with the given obfuscated name if its stored form is still malformed or
+  // corrupt, as checked by the above, so that Gets for it fail rather than return it.  Returns
+  // false, leaving the store unchanged, if the chunk is gone or is now intact.  Neither this nor
+  // the above counts towards OperationCount().
+  bool DeleteCorruptChunk(const NameType& obfuscated_name);
+  // Incremented by every Put, Get and Delete, so that background work can tell whether the store
+  // has been busy.
+  std::uint64_t OperationCount() const { return operation_count_.load(); }
+
+  // Both are zero if the store was constructed without a cache.
+  std::uint64_t CacheHits() const;
+  std::uint64_t CacheMisses() const;
+  // The number of Puts of ImmutableData skipped since construction because it was already stored.
+  std::uint64_t AvoidedWrites() const { return avoided_writes_.load(); }
+  // Latency and throughput of each kind of call since construction, which can be streamed to the
+  // log or a file.
+  ChunkStoreMetrics::Snapshot Metrics() const { return metrics_.TakeSnapshot(); }
+
+  DiskUsage MaxDiskUsage() const { return DiskUsage(max_disk_usage_.load()); }
+  DiskUsage CurrentDiskUsage() const { return DiskUsage(current_disk_usage_.load()); }
   boost::filesystem::path DiskPath() const { return kDiskPath_; }
+  // Restricts enumeration to one type and/or to names in [first, last).  Names are those reported
+  // by the store, i.e. obfuscated.
+  struct NameFilter {
+    boost::optional<DataTypeId> type_id;
+    boost::optional<Identity> first, last;
+  };
+
+  struct NamesPage {
+    std::vector<NameType> names;
+    // Passed to the next call to continue the enumeration; none once it is complete.
+    boost::optional<NameType> resume_after;
+  };
+
+  // Calls 'visitor' for each matching name, walking the top-level directories in parallel on the
+  // I/O threads.  'visitor' may be called concurrently and in no particular order.
+  void ForEachName(const NameFilter& filter,
+                   const std::function<void(const NameType&)>& visitor) const;
+  // Returns up to 'max_count' matching names after 'resume_after' in ascending order, listing only
+  // as many directories as that requires.  Chunks moved by a concurrent layout migration may be
+  // missed or repeated.
+  NamesPage GetNamesPage(const NameFilter& filter, std::size_t max_count,
+                         const boost::optional<NameType>& resume_after = boost::none) const;
+  // Every stored name; prefer the above for large stores.
   std::vector<NameType> Names() const;
 
  private:
-  bool HasDiskSpace(std::uint64_t required_space) const;
-  boost::filesystem::path NameToFilePath(NameType name) const;
-  void GetNames(const boost::filesystem::path& path, std::string prefix,
-                std::vector<NameType>& names) const;
-  NameType ComposeName(std::string file_name_str) const;
+  // Identifies a chunk within the backend.  The name is hashed so that the stored chunks can't be
+  // trivially matched to network names; 'file_path' is only set for the file-per-chunk backend,
+  // and 'legacy_file_path' only while migrating from the original directory layout.
+  struct ChunkKey {
+    NameType obfuscated_name;
+    boost::filesystem::path file_path, legacy_file_path;
+  };
+
+  struct Layout {
+    std::uint32_t width, depth;
+    bool migrating;
+    std::uint32_t chunk_format;
+  };
+
+  // Operations on chunks which map to different stripes never contend with each other.
+  static const std::size_t kStripeCount_ = 64;
+
+  std::size_t StripeIndex(const ChunkKey& chunk_key) const;
+  std::mutex& Stripe(const ChunkKey& chunk_key) const;
+  std::vector<std::unique_lock<std::mutex>> LockStripes(
+      const std::vector<std::pair<std::size_t, ChunkKey>>& chunk_keys) const;
+  void CheckDiskRoot() const;
+  // Converts between a chunk's value and its stored content, compressing if enabled.
+  NonEmptyString EncodeChunk(const NameType& name, const NonEmptyString& value) const;
+  NonEmptyString DecodeChunk(const NameType& name, std::vector<byte>&& content) const;
+  // These require the caller to hold the name's stripe.
+  // 'staged_path', if not empty, holds 'content' already (see StageChunk).
+  void DoPut(const ChunkKey& chunk_key, const NameType& name, const NonEmptyString& content,
+             const boost::filesystem::path& staged_path);
+  void DoDelete(const ChunkKey& chunk_key);
+  // False only if the existence filter is ready and certain that the chunk isn't stored.
+  bool MayBeStored(const ChunkKey& chunk_key) const;
+  // True if 'name' is ImmutableData which is already stored intact as 'value', in which case a Put
+  // can be skipped.  Chunks with a header are checked by it, before encoding.  Otherwise 'value' is
+  // encoded into 'content' to compare in full.  Takes the name's stripe.
+  bool ImmutableChunkStored(const ChunkKey& chunk_key, const NameType& name,
+                            const NonEmptyString& value, boost::optional<NonEmptyString>& content);
+  // Caches 'value' unless the chunk's stripe has been modified since 'generation' was read.
+  void CacheValue(const ChunkKey& chunk_key, std::uint64_t generation,
+                  const NonEmptyString& value) const;
+  // Atomically adds 'required_space' to the current usage if doing so won't exceed the max.
+  bool ReserveDiskSpace(std::uint64_t required_space);
+  void ReleaseDiskSpace(std::uint64_t space);
+  ChunkKey ToChunkKey(NameType name) const;
+  ChunkKey ObfuscatedChunkKey(NameType obfuscated_name) const;
+  // Returns the keys paired with their index in 'names', sorted by their location on disk.
+  std::vector<std::pair<std::size_t, ChunkKey>> ToSortedChunkKeys(
+      const std::vector<NameType>& names) const;
+  // Marks items in 'results' which succeeded but couldn't be synced as failed.
+  void SyncBatch(const std::vector<std::pair<std::size_t, ChunkKey>>& chunk_keys,
+                 bool sync_files, std::vector<maidsafe_error>& results) const;
+  // Reads the layout from the manifest, or creates the directories (unless using 'pack_store') and
+  // manifest for a new layout.
+  static Layout InitialiseLayout(const boost::filesystem::path& disk_root, const Options& options,
+                                 const PackStore* pack_store);
+  // Runs on 'background_thread_': completes any layout migration, then builds the existence
+  // filter.
+  void RunBackgroundTasks();
+  void MigrateLegacyLayout();
+  void BuildExistenceFilter();
+  // Both return false if anything couldn't be migrated.
+  bool MigrateLegacyDirectory(const boost::filesystem::path& directory,
+                              const std::string& prefix);
+  bool MigrateLegacyChunk(const boost::filesystem::path& legacy_path,
+                          const std::string& file_name);
+  boost::filesystem::path ChunkPath(const NameType& obfuscated_name, std::uint32_t width,
+                                    std::uint32_t depth) const;
+  // The legacy path if the chunk hasn't been migrated yet, otherwise its path in the new layout.
+  const boost::filesystem::path& ExistingFilePath(const ChunkKey& chunk_key) const;
+  std::uint64_t StoredSize(const ChunkKey& chunk_key) const;
+  // For kAtomic and kGroupCommit, writes 'content' to a uniquely named temporary file alongside
+  // the chunk and returns its path, otherwise returns an empty path.
+  boost::filesystem::path StageChunk(const ChunkKey& chunk_key, const NonEmptyString& content);
+  // For kGroupCommit, blocks until the chunk's last change is durable.
+  void CommitChunk(const ChunkKey& chunk_key);
+  bool WriteChunk(const ChunkKey& chunk_key, const std::vector<byte>& content,
+                  const boost::filesystem::path& staged_path);
+  // Writes a whole chunk file, bypassing the page cache if it's large enough.
+  bool WriteChunkFile(const boost::filesystem::path& path, const std::vector<byte>& content) const;
+  boost::optional<std::vector<byte>> ReadChunk(const ChunkKey& chunk_key) const;
+  // Up to 'length' bytes of the stored content from 'offset'.
+  boost::optional<std::vector<byte>> ReadChunkRange(const ChunkKey& chunk_key,
+                                                    std::uint64_t offset,
+                                                    std::uint64_t length) const;
+  // Returns the size of the removed chunk, including any stale legacy copy removed with it.
+  std::uint64_t RemoveChunk(const ChunkKey& chunk_key);
+  // Removes the legacy copy superseded by a Put, of which 'counted_size' bytes are still counted
+  // in the disk usage, and leaves the usage counting whatever remains on disk.
+  void RemoveLegacyCopy(const ChunkKey& chunk_key, std::uint64_t counted_size);
+  ThreadPool& IoThreads() const;
 
   const boost::filesystem::path kDiskPath_;
-  DiskUsage max_disk_usage_, current_disk_usage_;
-  const std::uint32_t kDepth_;
-  mutable std::mutex mutex_;
+  std::unique_ptr<PackStore> pack_store_;
+  std::unique_ptr<ChunkCache> cache_;
+  std::atomic<std::uint64_t> max_disk_usage_, current_disk_usage_;
+  const Layout kLayout_;
+  const bool kCompression_;
+  // Zero unless values are to be segmented.
+  const std::uint32_t kSegmentSize_;
+  const std::uint64_t kDirectIoThreshold_;
+  const Durability kDurability_;
+  std::atomic<std::uint64_t> staged_count_;
+  mutable std::atomic<std::uint64_t> operation_count_;
+  std::atomic<std::uint64_t> avoided_writes_;
+  mutable ChunkStoreMetrics metrics_;
+  // Only set for kGroupCommit.
+  std::unique_ptr<GroupCommitter> group_committer_;
+  std::unique_ptr<CountingBloomFilter> existence_filter_;
+  std::atomic<bool> migrating_, existence_filter_ready_, stop_background_;
+  std::thread background_thread_;
+  mutable std::array<std::mutex, kStripeCount_> stripes_;
+  // Bumped under the stripe on every Put or Delete, so that a value decrypted outside the lock is
+  // only cached if it's still current.
+  std::array<std::uint64_t, kStripeCount_> generations_;
+  // Drained first on destruction, so that outstanding asynchronous operations complete before
+  // anything they use is destroyed.
+  mutable std::once_flag io_threads_flag_;
+  mutable std::unique_ptr<ThreadPool> io_threads_;
 };
 
 }  // namespace vault
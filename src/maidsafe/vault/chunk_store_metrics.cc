@@ -0,0 +1,154 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/vault/chunk_store_metrics.h"
+
+#include <iomanip>
+
+namespace maidsafe {
+
+namespace vault {
+
+namespace {
+
+std::size_t Index(ChunkStoreMetrics::Operation operation) {
+  return static_cast<std::size_t>(operation);
+}
+
+std::size_t Index(ChunkStoreMetrics::Phase phase) { return static_cast<std::size_t>(phase); }
+
+void WriteSummary(std::ostream& stream, const char* name,
+                  const LatencyHistogram::Summary& summary) {
+  auto microseconds([](std::chrono::nanoseconds duration) {
+    return static_cast<double>(duration.count()) / 1000.0;
+  });
+  stream << "  " << std::left << std::setw(16) << name << std::right << " count "
+         << summary.count << std::fixed << std::setprecision(1) << "  mean "
+         << microseconds(summary.mean) << "  p50 " << microseconds(summary.p50) << "  p90 "
+         << microseconds(summary.p90) << "  p99 " << microseconds(summary.p99) << "  max "
+         << microseconds(summary.max) << '\n';
+}
+
+}  // unnamed namespace
+
+ChunkStoreMetrics::Timer::Timer(ChunkStoreMetrics& metrics, Operation operation,
+                                std::uint64_t chunks)
+    : metrics_(metrics),
+      kOperation_(operation),
+      kChunks_(chunks),
+      kStart_(std::chrono::steady_clock::now()),
+      lap_start_(kStart_),
+      phase_durations_(),
+      phases_timed_(),
+      bytes_(0) {}
+
+ChunkStoreMetrics::Timer::~Timer() {
+  auto& operation(metrics_.operations_[Index(kOperation_)]);
+  operation.total.Record(std::chrono::steady_clock::now() - kStart_);
+  for (std::size_t i(0); i != kPhaseCount; ++i) {
+    if (phases_timed_[i])
+      operation.phases[i].Record(phase_durations_[i]);
+  }
+  operation.calls.fetch_add(1, std::memory_order_relaxed);
+  operation.chunks.fetch_add(kChunks_, std::memory_order_relaxed);
+  operation.bytes.fetch_add(bytes_, std::memory_order_relaxed);
+}
+
+void ChunkStoreMetrics::Timer::Lap(Phase phase) {
+  const auto now(std::chrono::steady_clock::now());
+  phase_durations_[Index(phase)] += now - lap_start_;
+  phases_timed_[Index(phase)] = true;
+  lap_start_ = now;
+}
+
+ChunkStoreMetrics::ChunkStoreMetrics() : operations_() {}
+
+ChunkStoreMetrics::Snapshot ChunkStoreMetrics::TakeSnapshot() const {
+  Snapshot snapshot;
+  for (std::size_t i(0); i != kOperationCount; ++i) {
+    const auto& operation(operations_[i]);
+    auto& operation_snapshot(snapshot.operations[i]);
+    operation_snapshot.calls = operation.calls.load(std::memory_order_relaxed);
+    operation_snapshot.chunks = operation.chunks.load(std::memory_order_relaxed);
+    operation_snapshot.bytes = operation.bytes.load(std::memory_order_relaxed);
+    operation_snapshot.total = operation.total.Summarise();
+    for (std::size_t j(0); j != kPhaseCount; ++j)
+      operation_snapshot.phases[j] = operation.phases[j].Summarise();
+  }
+  return snapshot;
+}
+
+const char* ToString(ChunkStoreMetrics::Operation operation) {
+  switch (operation) {
+    case ChunkStoreMetrics::Operation::kPut:
+      return "Put";
+    case ChunkStoreMetrics::Operation::kGet:
+      return "Get";
+    case ChunkStoreMetrics::Operation::kGetRange:
+      return "GetRange";
+    case ChunkStoreMetrics::Operation::kDelete:
+      return "Delete";
+    case ChunkStoreMetrics::Operation::kPutMany:
+      return "PutMany";
+    case ChunkStoreMetrics::Operation::kGetMany:
+      return "GetMany";
+    case ChunkStoreMetrics::Operation::kDeleteMany:
+      return "DeleteMany";
+  }
+  return "Unknown";
+}
+
+const char* ToString(ChunkStoreMetrics::Phase phase) {
+  switch (phase) {
+    case ChunkStoreMetrics::Phase::kLockWait:
+      return "lock wait";
+    case ChunkStoreMetrics::Phase::kCrypto:
+      return "crypto";
+    case ChunkStoreMetrics::Phase::kPathResolution:
+      return "path resolution";
+    case ChunkStoreMetrics::Phase::kDiskIo:
+      return "disk I/O";
+  }
+  return "unknown";
+}
+
+std::ostream& operator<<(std::ostream& stream, const ChunkStoreMetrics::Snapshot& snapshot) {
+  const auto flags(stream.flags());
+  const auto precision(stream.precision());
+  for (std::size_t i(0); i != ChunkStoreMetrics::kOperationCount; ++i) {
+    const auto& operation(snapshot.operations[i]);
+    if (operation.calls == 0)
+      continue;
+    stream << ToString(static_cast<ChunkStoreMetrics::Operation>(i)) << ": " << operation.calls
+           << " calls, " << operation.chunks << " chunks, " << operation.bytes << " bytes\n";
+    WriteSummary(stream, "total", operation.total);
+    for (std::size_t j(0); j != ChunkStoreMetrics::kPhaseCount; ++j) {
+      if (operation.phases[j].count != 0) {
+        WriteSummary(stream, ToString(static_cast<ChunkStoreMetrics::Phase>(j)),
+                     operation.phases[j]);
+      }
+    }
+  }
+  stream.flags(flags);
+  stream.precision(precision);
+  return stream;
+}
+
+}  // namespace vault
+
+}  // namespace maidsafe
@@ -0,0 +1,113 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_VAULT_CHUNK_STORE_METRICS_H_
+#define MAIDSAFE_VAULT_CHUNK_STORE_METRICS_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+#include "maidsafe/vault/latency_histogram.h"
+
+namespace maidsafe {
+
+namespace vault {
+
+// Latency histograms and counters for each kind of ChunkStore call.  Each call's time is split
+// into the phases below, so that a slow store can be identified as contended, CPU-bound or
+// disk-bound.  Time not attributed to any phase, e.g. space accounting, only counts towards the
+// total.  Batch calls are recorded separately from single ones, as each is timed as a whole.
+class ChunkStoreMetrics {
+ public:
+  enum class Operation { kPut, kGet, kGetRange, kDelete, kPutMany, kGetMany, kDeleteMany };
+  // kCrypto includes compression, and kPathResolution includes hashing the name.  Batch calls
+  // encode and stage their chunks in parallel, which is counted as kCrypto.
+  enum class Phase { kLockWait, kCrypto, kPathResolution, kDiskIo };
+  static const std::size_t kOperationCount = 7;
+  static const std::size_t kPhaseCount = 4;
+
+  struct OperationSnapshot {
+    // 'chunks' and 'bytes' (of values) count the items in batch calls individually.
+    std::uint64_t calls, chunks, bytes;
+    LatencyHistogram::Summary total;
+    std::array<LatencyHistogram::Summary, kPhaseCount> phases;
+  };
+
+  struct Snapshot {
+    std::array<OperationSnapshot, kOperationCount> operations;
+  };
+
+  // Times one call, attributing the time since the previous lap (or construction) to a phase on
+  // each call to Lap.  Everything is recorded on destruction, so that failed calls are included.
+  class Timer {
+   public:
+    Timer(ChunkStoreMetrics& metrics, Operation operation, std::uint64_t chunks = 1);
+    ~Timer();
+    Timer(const Timer&) = delete;
+    Timer(Timer&&) = delete;
+    Timer& operator=(const Timer&) = delete;
+    Timer& operator=(Timer&&) = delete;
+
+    void Lap(Phase phase);
+    void AddBytes(std::uint64_t bytes) { bytes_ += bytes; }
+
+   private:
+    ChunkStoreMetrics& metrics_;
+    const Operation kOperation_;
+    const std::uint64_t kChunks_;
+    const std::chrono::steady_clock::time_point kStart_;
+    std::chrono::steady_clock::time_point lap_start_;
+    std::array<std::chrono::nanoseconds, kPhaseCount> phase_durations_;
+    std::array<bool, kPhaseCount> phases_timed_;
+    std::uint64_t bytes_;
+  };
+
+  ChunkStoreMetrics();
+  ChunkStoreMetrics(const ChunkStoreMetrics&) = delete;
+  ChunkStoreMetrics(ChunkStoreMetrics&&) = delete;
+  ChunkStoreMetrics& operator=(const ChunkStoreMetrics&) = delete;
+  ChunkStoreMetrics& operator=(ChunkStoreMetrics&&) = delete;
+
+  Snapshot TakeSnapshot() const;
+
+ private:
+  struct OperationMetrics {
+    OperationMetrics() : calls(0), chunks(0), bytes(0), total(), phases() {}
+    std::atomic<std::uint64_t> calls, chunks, bytes;
+    LatencyHistogram total;
+    std::array<LatencyHistogram, kPhaseCount> phases;
+  };
+
+  std::array<OperationMetrics, kOperationCount> operations_;
+};
+
+const char* ToString(ChunkStoreMetrics::Operation operation);
+const char* ToString(ChunkStoreMetrics::Phase phase);
+
+// Writes one line per operation which has been called, followed by a line per timed phase, with
+// durations in microseconds.  Suitable for the log or a file.
+std::ostream& operator<<(std::ostream& stream, const ChunkStoreMetrics::Snapshot& snapshot);
+
+}  // namespace vault
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_VAULT_CHUNK_STORE_METRICS_H_
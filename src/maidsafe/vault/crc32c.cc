@@ -0,0 +1,100 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/vault/crc32c.h"
+
+#include <array>
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define MAIDSAFE_VAULT_HARDWARE_CRC32C
+#include <nmmintrin.h>
+#endif
+
+namespace maidsafe {
+
+namespace vault {
+
+namespace {
+
+// The reflected Castagnoli polynomial.
+const std::uint32_t kPolynomial(0x82f63b78);
+
+std::array<std::uint32_t, 256> MakeTable() {
+  std::array<std::uint32_t, 256> table;
+  for (std::uint32_t i(0); i != table.size(); ++i) {
+    std::uint32_t crc(i);
+    for (int bit(0); bit != 8; ++bit)
+      crc = (crc >> 1) ^ (kPolynomial & (0U - (crc & 1)));
+    table[i] = crc;
+  }
+  return table;
+}
+
+std::uint32_t SoftwareCrc32c(const byte* data, std::size_t size, std::uint32_t crc) {
+  static const std::array<std::uint32_t, 256> table(MakeTable());
+  for (std::size_t i(0); i != size; ++i)
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  return crc;
+}
+
+#ifdef MAIDSAFE_VAULT_HARDWARE_CRC32C
+
+__attribute__((target("sse4.2"))) std::uint32_t HardwareCrc32c(const byte* data,
+                                                               std::size_t size,
+                                                               std::uint32_t crc) {
+#ifdef __x86_64__
+  std::uint64_t crc64(crc);
+  for (; size >= 8; data += 8, size -= 8) {
+    std::uint64_t word;
+    std::memcpy(&word, data, sizeof(word));
+    crc64 = _mm_crc32_u64(crc64, word);
+  }
+  crc = static_cast<std::uint32_t>(crc64);
+#endif
+  for (; size >= 4; data += 4, size -= 4) {
+    std::uint32_t word;
+    std::memcpy(&word, data, sizeof(word));
+    crc = _mm_crc32_u32(crc, word);
+  }
+  for (; size != 0; ++data, --size)
+    crc = _mm_crc32_u8(crc, *data);
+  return crc;
+}
+
+bool HasHardwareCrc32c() {
+  static const bool has_sse4_2(__builtin_cpu_supports("sse4.2") != 0);
+  return has_sse4_2;
+}
+
+#endif
+
+}  // unnamed namespace
+
+std::uint32_t Crc32c(const byte* data, std::size_t size, std::uint32_t crc) {
+  crc = ~crc;
+#ifdef MAIDSAFE_VAULT_HARDWARE_CRC32C
+  if (HasHardwareCrc32c())
+    return ~HardwareCrc32c(data, size, crc);
+#endif
+  return ~SoftwareCrc32c(data, size, crc);
+}
+
+}  // namespace vault
+
+}  // namespace maidsafe
@@ -0,0 +1,40 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_VAULT_CRC32C_H_
+#define MAIDSAFE_VAULT_CRC32C_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "maidsafe/common/types.h"
+
+namespace maidsafe {
+
+namespace vault {
+
+// CRC-32C (Castagnoli), as used by iSCSI and ext4.  Computed with the SSE4.2 crc32 instruction
+// where the CPU supports it, which runs at close to memory bandwidth, and with a table otherwise.
+// 'crc' is the result for the preceding data, so a checksum can be computed in pieces.
+std::uint32_t Crc32c(const byte* data, std::size_t size, std::uint32_t crc = 0);
+
+}  // namespace vault
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_VAULT_CRC32C_H_
@@ -34,6 +34,7 @@ template <typename FacadeType>
 class DataManager {
  public:
   explicit DataManager(const boost::filesystem::path& vault_root_dir);
+  ~DataManager();
 
   template <typename DataType>
   routing::HandleGetReturn HandleGet(const routing::SourceAddress& from, const Identity& name);
@@ -64,14 +65,23 @@ template <typename FacadeType>
 DataManager<FacadeType>::DataManager(const boost::filesystem::path& vault_root_dir)
     : db_(UniqueDbPath(vault_root_dir)) {}
 
+template <typename FacadeType>
+DataManager<FacadeType>::~DataManager() {
+  LOG(kInfo) << "Holder cache: " << db_.CacheHits() << " hits, " << db_.CacheMisses()
+             << " misses.";
+}
+
 template <typename FacadeType>
 template <typename DataType>
 routing::HandlePutPostReturn DataManager<FacadeType>::HandlePut(
     const routing::SourceAddress& /*from*/, const DataType& data) {
-  if (!db_.Exist<DataType>(data.Name())) {
-     auto pmid_addresses(static_cast<FacadeType*>(this)
-                             ->template GetClosestNodes<DataType>(data.Name()));
-    db_.Put<DataType>(data.Name(), pmid_addresses);
+  // Accounts are never deleted, so a chunk already stored needs no holders choosing.  Mostly
+  // answered from the holder cache, this saves a routing lookup on every repeated Put.
+  if (db_.Exist<DataType>(data.Name()))
+    return boost::make_unexpected(MakeError(CommonErrors::success));
+  auto pmid_addresses(static_cast<FacadeType*>(this)
+                          ->template GetClosestNodes<DataType>(data.Name()));
+  if (db_.InsertIfAbsent<DataType>(data.Name(), pmid_addresses).changed) {
     std::vector<routing::DestinationAddress> dest_addresses;
     for (const auto& pmid_address : pmid_addresses)
       dest_addresses.emplace_back(std::make_pair(routing::Destination(pmid_address),
@@ -97,36 +107,26 @@ template <typename DataType>
 routing::HandlePutPostReturn
 DataManager<FacadeType>::Replicate(const Identity& name,
                                    const routing::DestinationAddress& from) {
-  std::vector<routing::Address> new_pmid_nodes;
-  bool is_holder(false);
-
-  auto result(db_.GetPmids<DataType>(name));
+  auto result(db_.RemoveHolder<DataType>(name, from.first.data));
   if (!result.valid())
     return boost::make_unexpected(result.error());
 
-  auto& current_pmid_nodes(*result);
-  is_holder = (std::any_of(current_pmid_nodes.begin(), current_pmid_nodes.end(),
-                           [&](const routing::Address& pmid) { return pmid == from.first.data; }));
-  if (current_pmid_nodes.size() > Parameters::min_pmid_holders) {
-    if (is_holder)
-      db_.RemovePmid<DataType>(name, from);
+  // Counted as they were before 'from' was removed.
+  auto& current_pmid_nodes(result->pmid_nodes);
+  if (current_pmid_nodes.size() + (result->changed ? 1 : 0) > Parameters::min_pmid_holders)
     return boost::make_unexpected(MakeError(CommonErrors::success));
-  }
 
-  new_pmid_nodes = static_cast<FacadeType*>(this)
-                       ->template GetClosestNodes<DataType>(name, current_pmid_nodes);
+  std::vector<routing::Address> exclude(current_pmid_nodes);
+  exclude.push_back(from.first.data);
+  auto new_pmid_nodes(static_cast<FacadeType*>(this)
+                          ->template GetClosestNodes<DataType>(name, exclude));
   if (new_pmid_nodes.empty()) {
-    if (is_holder)
-      db_.RemovePmid<DataType>(name, from);
     LOG(kError) << "Failed to find a valid close pmid node";
     return boost::make_unexpected(MakeError(CommonErrors::unable_to_handle_request));
   }
-  current_pmid_nodes.erase(std::remove(current_pmid_nodes.begin(), current_pmid_nodes.end(),
-                                       from.first.data),
-                           current_pmid_nodes.end());
-  current_pmid_nodes.insert(current_pmid_nodes.end(), new_pmid_nodes.begin(),
-                            new_pmid_nodes.end());
-  db_.ReplacePmidNodes<DataType>(name, current_pmid_nodes);
+  auto added(db_.AddHolders<DataType>(name, new_pmid_nodes));
+  if (!added.valid())
+    return boost::make_unexpected(added.error());
 
   std::vector<routing::DestinationAddress> dest_addresses;
   for (const auto& pmid_address : new_pmid_nodes)
@@ -16,7 +16,10 @@
     See the Licences for the specific language governing permissions and limitations relating to
     use of the MaidSafe Software.                                                                 */
 
+#include <algorithm>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "boost/filesystem.hpp"
 
@@ -26,21 +29,80 @@ namespace maidsafe {
 
 namespace vault {
 
-DataManagerDatabase::DataManagerDatabase(const boost::filesystem::path& db_path)
-    : database_(), kDbPath_(db_path), write_operations_(0) {
+DataManagerDatabase::DataManagerDatabase(const boost::filesystem::path& db_path,
+                                         std::chrono::milliseconds commit_window,
+                                         std::size_t max_commit_size,
+                                         std::size_t holder_cache_size)
+    : database_(),
+      insert_chunk_statement_(),
+      delete_holders_statement_(),
+      insert_holder_statement_(),
+      delete_holder_statement_(),
+      get_pmids_statement_(),
+      get_chunks_statement_(),
+      exist_statement_(),
+      mutex_(),
+      kDbPath_(db_path),
+      write_operations_(0),
+      holder_cache_(holder_cache_size),
+      write_batcher_() {
   database_.reset(new sqlite::Database(kDbPath_,
                                         sqlite::Mode::kReadWriteCreate));
-  std::string query(
-      "CREATE TABLE IF NOT EXISTS DataManagerAccounts ("
-      "ChunkName TEXT  PRIMARY KEY NOT NULL, PmidNodes TEXT NOT NULL);");
+  // Each holder of a chunk is a row of its own, keyed by the chunk's encoded name and the holder's
+  // raw address, so one holder can be added or dropped without rewriting the rest.  The index on
+  // holders lets the chunks held by a given PmidNode be found without a table scan; since the
+  // holders table has no rowid, that index carries ChunkName too and covers the lookup alone.  Both
+  // are declared TEXT, as that's how they're bound; comparisons still use the binary collation.
+  const char* const kSchema[] = {
+      "CREATE TABLE IF NOT EXISTS DataManagerChunks ("
+      "ChunkName TEXT PRIMARY KEY NOT NULL) WITHOUT ROWID;",
+      "CREATE TABLE IF NOT EXISTS DataManagerHolders ("
+      "ChunkName TEXT NOT NULL, PmidNode TEXT NOT NULL, "
+      "PRIMARY KEY (ChunkName, PmidNode)) WITHOUT ROWID;",
+      "CREATE INDEX IF NOT EXISTS DataManagerHoldersByPmidNode ON DataManagerHolders (PmidNode);"};
   sqlite::Transaction transaction{*database_};
-  sqlite::Statement statement{*database_, query};
-  statement.Step();
+  for (const auto& query : kSchema) {
+    sqlite::Statement statement{*database_, query};
+    statement.Step();
+  }
   transaction.Commit();
+
+  insert_chunk_statement_.reset(new sqlite::Statement(
+      *database_, "INSERT OR IGNORE INTO DataManagerChunks (ChunkName) VALUES (?)"));
+  delete_holders_statement_.reset(new sqlite::Statement(
+      *database_, "DELETE FROM DataManagerHolders WHERE ChunkName = ?"));
+  insert_holder_statement_.reset(new sqlite::Statement(
+      *database_,
+      "INSERT OR IGNORE INTO DataManagerHolders (ChunkName, PmidNode) VALUES (?, ?)"));
+  delete_holder_statement_.reset(new sqlite::Statement(
+      *database_, "DELETE FROM DataManagerHolders WHERE ChunkName = ? AND PmidNode = ?"));
+  // Yields one row per holder, or a single empty one for an account which has none, and no rows
+  // if there's no account.
+  get_pmids_statement_.reset(new sqlite::Statement(
+      *database_,
+      "SELECT COALESCE(Holders.PmidNode, '') FROM DataManagerChunks AS Chunks "
+      "LEFT JOIN DataManagerHolders AS Holders ON Holders.ChunkName = Chunks.ChunkName "
+      "WHERE Chunks.ChunkName = ?"));
+  get_chunks_statement_.reset(new sqlite::Statement(
+      *database_, "SELECT ChunkName FROM DataManagerHolders WHERE PmidNode = ?"));
+  exist_statement_.reset(new sqlite::Statement(
+      *database_, "SELECT 1 FROM DataManagerChunks WHERE ChunkName = ?"));
+  write_batcher_.reset(new TransactionBatcher(*database_, mutex_, commit_window, max_commit_size,
+                                              [this] { CheckPoint(); }));
 }
 
 DataManagerDatabase::~DataManagerDatabase() {
   try {
+    // Pending writes are committed first, and statements must be finalised before their database
+    // is closed.
+    write_batcher_.reset();
+    insert_chunk_statement_.reset();
+    delete_holders_statement_.reset();
+    insert_holder_statement_.reset();
+    delete_holder_statement_.reset();
+    get_pmids_statement_.reset();
+    get_chunks_statement_.reset();
+    exist_statement_.reset();
     database_.reset();
     boost::filesystem::remove_all(kDbPath_);
   }
@@ -49,6 +111,213 @@ DataManagerDatabase::~DataManagerDatabase() {
   }
 }
 
+std::vector<Data::NameAndTypeId> DataManagerDatabase::GetChunks(
+    const routing::Address& pmid_node) {
+  if (!database_)
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::db_not_present));
+
+  std::vector<Data::NameAndTypeId> chunks;
+  std::lock_guard<std::mutex> lock(mutex_);
+  ScopedStatementReset reset(*get_chunks_statement_);
+  get_chunks_statement_->BindText(1, convert::ToString(pmid_node.string()));
+  while (get_chunks_statement_->Step() == sqlite::StepResult::kSqliteRow) {
+    // The key is the chunk's name followed by its type id, as written by EncodeToString.
+    const std::string chunk_name(get_chunks_statement_->ColumnText(0));
+    assert(chunk_name.size() == identity_size + PaddedWidth::value);
+    chunks.emplace_back(
+        Identity(std::vector<byte>(chunk_name.begin(), chunk_name.begin() + identity_size)),
+        DataTypeId(static_cast<unsigned char>(chunk_name[identity_size])));
+  }
+  return chunks;
+}
+
+bool DataManagerDatabase::DoExist(const std::string& chunk_name) {
+  if (!database_)
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::db_not_present));
+
+  if (holder_cache_.Contains(chunk_name))
+    return true;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  ScopedStatementReset reset(*exist_statement_);
+  exist_statement_->BindText(1, chunk_name);
+  return exist_statement_->Step() == sqlite::StepResult::kSqliteRow;
+}
+
+void DataManagerDatabase::DoPut(const std::string& chunk_name,
+                                const std::vector<routing::Address>& pmid_nodes) {
+  if (!database_)
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::db_not_present));
+
+  write_batcher_->Apply([&] { WritePmids(chunk_name, pmid_nodes); },
+                        [&] { holder_cache_.Put(chunk_name, pmid_nodes); });
+}
+
+DataManagerDatabase::HolderSet DataManagerDatabase::DoInsertIfAbsent(
+    const std::string& chunk_name, const std::vector<routing::Address>& pmid_nodes) {
+  if (!database_)
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::db_not_present));
+
+  // Accounts are never deleted, so one found in the cache needn't be checked for in a transaction.
+  auto cached(holder_cache_.Get(chunk_name));
+  if (cached)
+    return HolderSet{std::move(*cached), false};
+
+  HolderSet result{std::vector<routing::Address>(), false};
+  write_batcher_->Apply([&] {
+    auto current(CurrentPmids(chunk_name));
+    if (current.valid()) {
+      result = HolderSet{std::move(*current), false};
+      return;
+    }
+    WritePmids(chunk_name, pmid_nodes);
+    result = HolderSet{pmid_nodes, true};
+  }, [&] { CacheCommitted(chunk_name, result); });
+  return result;
+}
+
+DataManagerDatabase::UpdateResult DataManagerDatabase::DoAddHolders(
+    const std::string& chunk_name, const std::vector<routing::Address>& pmid_nodes) {
+  if (!database_)
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::db_not_present));
+
+  UpdateResult result;
+  write_batcher_->Apply([&] {
+    auto current(CurrentPmids(chunk_name));
+    if (!current.valid()) {
+      result = boost::make_unexpected(current.error());
+      return;
+    }
+    HolderSet holders{std::move(*current), false};
+    for (const auto& pmid_node : pmid_nodes) {
+      if (std::find(holders.pmid_nodes.begin(), holders.pmid_nodes.end(), pmid_node) !=
+          holders.pmid_nodes.end()) {
+        continue;
+      }
+      InsertHolder(chunk_name, pmid_node);
+      holders.pmid_nodes.push_back(pmid_node);
+      holders.changed = true;
+    }
+    if (holders.changed)
+      holder_cache_.Erase(chunk_name);
+    result = std::move(holders);
+  }, [&] {
+    if (result.valid())
+      CacheCommitted(chunk_name, *result);
+  });
+  return result;
+}
+
+DataManagerDatabase::UpdateResult DataManagerDatabase::DoRemoveHolder(
+    const std::string& chunk_name, const routing::Address& pmid_node) {
+  if (!database_)
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::db_not_present));
+
+  UpdateResult result;
+  write_batcher_->Apply([&] {
+    auto current(CurrentPmids(chunk_name));
+    if (!current.valid()) {
+      result = boost::make_unexpected(current.error());
+      return;
+    }
+    HolderSet holders{std::move(*current), false};
+    auto itr(std::find(holders.pmid_nodes.begin(), holders.pmid_nodes.end(), pmid_node));
+    if (itr != holders.pmid_nodes.end()) {
+      DeleteHolder(chunk_name, pmid_node);
+      holders.pmid_nodes.erase(itr);
+      holders.changed = true;
+      holder_cache_.Erase(chunk_name);
+    }
+    result = std::move(holders);
+  }, [&] {
+    if (result.valid())
+      CacheCommitted(chunk_name, *result);
+  });
+  return result;
+}
+
+DataManagerDatabase::GetPmidsResult DataManagerDatabase::DoGetPmids(
+    const std::string& chunk_name) {
+  if (!database_)
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::db_not_present));
+
+  auto cached(holder_cache_.Get(chunk_name));
+  if (cached)
+    return std::move(*cached);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto pmid_nodes(ReadPmids(chunk_name));
+  if (pmid_nodes.valid())
+    holder_cache_.Put(chunk_name, *pmid_nodes);
+  return pmid_nodes;
+}
+
+void DataManagerDatabase::CacheCommitted(const std::string& chunk_name, const HolderSet& holders) {
+  if (holders.changed)
+    holder_cache_.Put(chunk_name, holders.pmid_nodes);
+}
+
+DataManagerDatabase::GetPmidsResult DataManagerDatabase::CurrentPmids(
+    const std::string& chunk_name) {
+  auto cached(holder_cache_.Get(chunk_name));
+  if (cached)
+    return std::move(*cached);
+  return ReadPmids(chunk_name);
+}
+
+DataManagerDatabase::GetPmidsResult DataManagerDatabase::ReadPmids(
+    const std::string& chunk_name) {
+  std::vector<routing::Address> pmid_nodes;
+  bool account_exists(false);
+  ScopedStatementReset reset(*get_pmids_statement_);
+  get_pmids_statement_->BindText(1, chunk_name);
+  while (get_pmids_statement_->Step() == sqlite::StepResult::kSqliteRow) {
+    account_exists = true;
+    // Each row holds a single holder, so its column is read once and moved into the result.
+    std::string pmid_node(get_pmids_statement_->ColumnText(0));
+    if (pmid_node.empty())
+      break;
+    assert(pmid_node.size() == identity_size);
+    pmid_nodes.emplace_back(std::move(pmid_node));
+  }
+  if (!account_exists)
+    return boost::make_unexpected(MakeError(VaultErrors::no_such_account));
+  return pmid_nodes;
+}
+
+void DataManagerDatabase::WritePmids(const std::string& chunk_name,
+                                     const std::vector<routing::Address>& pmid_nodes) {
+  {
+    ScopedStatementReset reset(*insert_chunk_statement_);
+    insert_chunk_statement_->BindText(1, chunk_name);
+    insert_chunk_statement_->Step();
+  }
+  {
+    ScopedStatementReset reset(*delete_holders_statement_);
+    delete_holders_statement_->BindText(1, chunk_name);
+    delete_holders_statement_->Step();
+  }
+  for (const auto& pmid_node : pmid_nodes)
+    InsertHolder(chunk_name, pmid_node);
+  holder_cache_.Erase(chunk_name);
+}
+
+void DataManagerDatabase::InsertHolder(const std::string& chunk_name,
+                                       const routing::Address& pmid_node) {
+  ScopedStatementReset reset(*insert_holder_statement_);
+  insert_holder_statement_->BindText(1, chunk_name);
+  insert_holder_statement_->BindText(2, convert::ToString(pmid_node.string()));
+  insert_holder_statement_->Step();
+}
+
+void DataManagerDatabase::DeleteHolder(const std::string& chunk_name,
+                                       const routing::Address& pmid_node) {
+  ScopedStatementReset reset(*delete_holder_statement_);
+  delete_holder_statement_->BindText(1, chunk_name);
+  delete_holder_statement_->BindText(2, convert::ToString(pmid_node.string()));
+  delete_holder_statement_->Step();
+}
+
 void DataManagerDatabase::CheckPoint() {
   if (++write_operations_ > 1000) {
     database_->CheckPoint();
@@ -19,15 +19,23 @@
 #ifndef MAIDSAFE_VAULT_DATA_MANAGER_DATABASE_H_
 #define MAIDSAFE_VAULT_DATA_MANAGER_DATABASE_H_
 
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
 #include "maidsafe/common/sqlite3_wrapper.h"
 
 #include "maidsafe/common/convert.h"
+#include "maidsafe/common/data_types/data.h"
 #include "maidsafe/routing/types.h"
 
+#include "maidsafe/vault/sqlite_utils.h"
+#include "maidsafe/vault/transaction_batcher.h"
 #include "maidsafe/vault/utils.h"
+#include "maidsafe/vault/data_manager/holder_cache.h"
 
 namespace maidsafe {
 
@@ -36,7 +44,21 @@ namespace vault {
 class DataManagerDatabase {
  public:
   using GetPmidsResult = boost::expected<std::vector<routing::Address>, maidsafe_error>;
-  explicit DataManagerDatabase(const boost::filesystem::path& db_path);
+  // An account's holders after a conditional write, and whether the write changed the account.
+  struct HolderSet {
+    std::vector<routing::Address> pmid_nodes;
+    bool changed;
+  };
+  using UpdateResult = boost::expected<HolderSet, maidsafe_error>;
+  // Writes from concurrent callers are committed together, in a transaction once one has been
+  // collecting writes for 'commit_window' or holds 'max_commit_size' of them.  Each write returns
+  // only once committed.  The holders of up to 'holder_cache_size' recently used chunks are also
+  // kept in memory, and updated by each write once it has committed.
+  explicit DataManagerDatabase(const boost::filesystem::path& db_path,
+                               std::chrono::milliseconds commit_window =
+                                   std::chrono::milliseconds(2),
+                               std::size_t max_commit_size = 64,
+                               std::size_t holder_cache_size = 64 * 1024);
   ~DataManagerDatabase();
 
   template <typename DataType>
@@ -51,36 +73,81 @@ class DataManagerDatabase {
   template <typename DataType>
   maidsafe_error RemovePmid(const Identity& name, const routing::DestinationAddress& remove_pmid);
 
+  // Each of the following checks the account and updates it in a single transaction, so is atomic
+  // with respect to every other write.
+
+  // Creates the account with 'pmid_nodes' as its holders, unless it already exists.
+  template <typename DataType>
+  HolderSet InsertIfAbsent(const Identity& name, const std::vector<routing::Address>& pmid_nodes);
+
+  // Adds those of 'pmid_nodes' which aren't already holders.  Fails if there's no account.
+  template <typename DataType>
+  UpdateResult AddHolders(const Identity& name, const std::vector<routing::Address>& pmid_nodes);
+
+  // Removes 'pmid_node' if it's a holder.  Fails if there's no account.
+  template <typename DataType>
+  UpdateResult RemoveHolder(const Identity& name, const routing::Address& pmid_node);
+
+  // Holders aren't returned in any particular order.
   template <typename DataType>
   GetPmidsResult GetPmids(const Identity& name);
 
+  // Returns the chunks 'pmid_node' is recorded as holding, looked up through the index on holders
+  // rather than by scanning every account.
+  std::vector<Data::NameAndTypeId> GetChunks(const routing::Address& pmid_node);
+
+  // Lookups by Exist and GetPmids answered from, or missing, the holder cache.
+  std::uint64_t CacheHits() const { return holder_cache_.Hits(); }
+  std::uint64_t CacheMisses() const { return holder_cache_.Misses(); }
+
  private:
+  bool DoExist(const std::string& chunk_name);
+  void DoPut(const std::string& chunk_name, const std::vector<routing::Address>& pmid_nodes);
+  HolderSet DoInsertIfAbsent(const std::string& chunk_name,
+                             const std::vector<routing::Address>& pmid_nodes);
+  UpdateResult DoAddHolders(const std::string& chunk_name,
+                            const std::vector<routing::Address>& pmid_nodes);
+  UpdateResult DoRemoveHolder(const std::string& chunk_name, const routing::Address& pmid_node);
+  GetPmidsResult DoGetPmids(const std::string& chunk_name);
+
+  // Caches the holders left by a committed write, if it changed them.
+  void CacheCommitted(const std::string& chunk_name, const HolderSet& holders);
+  // The following must be called holding 'mutex_', and those which write only from a write passed
+  // to 'write_batcher_'.  None fills the cache, since what they read may not be committed yet.
+  GetPmidsResult CurrentPmids(const std::string& chunk_name);
+  GetPmidsResult ReadPmids(const std::string& chunk_name);
+  void WritePmids(const std::string& chunk_name, const std::vector<routing::Address>& pmid_nodes);
+  void InsertHolder(const std::string& chunk_name, const routing::Address& pmid_node);
+  void DeleteHolder(const std::string& chunk_name, const routing::Address& pmid_node);
   void CheckPoint();
 
   std::unique_ptr<sqlite::Database> database_;
+  // Prepared once and reused, so that SQLite doesn't re-parse and re-plan each query.  'mutex_'
+  // serialises their use.
+  std::unique_ptr<sqlite::Statement> insert_chunk_statement_, delete_holders_statement_,
+      insert_holder_statement_, delete_holder_statement_, get_pmids_statement_,
+      get_chunks_statement_, exist_statement_;
+  std::mutex mutex_;
   const boost::filesystem::path kDbPath_;
   int write_operations_;
+  // Only ever holds committed holders.  It's filled while holding 'mutex_', by lookups and by writes
+  // once their batch has committed, so that a lookup which misses can't replace a newer write's
+  // holders with the older ones it read.  A write erases the chunk's entry as it runs, so that later
+  // writes in its batch read its holders from the uncommitted transaction instead.  Erasing an
+  // entry is always safe, so needn't hold 'mutex_'.
+  HolderCache holder_cache_;
+  std::unique_ptr<TransactionBatcher> write_batcher_;
 };
 
+template <typename DataType>
+bool DataManagerDatabase::Exist(const Identity& name) {
+  return DoExist(EncodeToString<DataType>(name));
+}
+
 template <typename DataType>
 void DataManagerDatabase::Put(const Identity& name,
                               const std::vector<routing::Address>& pmid_nodes) {
-  if (!database_)
-    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::db_not_present));
-
-  std::string pmids_str;
-
-  CheckPoint();
-  sqlite::Transaction transaction{*database_};
-  std::string query(
-      "INSERT OR REPLACE INTO DataManagerAccounts (ChunkName, PmidNodes) VALUES (?, ?)");
-  sqlite::Statement statement{*database_, query};
-  statement.BindText(1, EncodeToString<DataType>(name));
-  for (const auto& pmid_node : pmid_nodes)
-    pmids_str += convert::ToString(pmid_node.string());
-  statement.BindText(2, pmids_str);
-  statement.Step();
-  transaction.Commit();
+  DoPut(EncodeToString<DataType>(name), pmid_nodes);
 }
 
 template <typename DataType>
@@ -92,58 +159,33 @@ void DataManagerDatabase::ReplacePmidNodes(const Identity& name,
 template <typename DataType>
 maidsafe_error DataManagerDatabase::RemovePmid(const Identity& name,
                                                const routing::DestinationAddress& remove_pmid) {
-  auto result(GetPmids<DataType>(name));
+  auto result(RemoveHolder<DataType>(name, remove_pmid.first.data));
   if (!result.valid())
     return result.error();
+  return maidsafe_error(result->changed ? CommonErrors::success : CommonErrors::no_such_element);
+}
 
-  auto& pmid_nodes(*result);
-  if (std::any_of(pmid_nodes.begin(), pmid_nodes.end(), [&](const routing::Address& pmid_node) {
-        return pmid_node == remove_pmid.first.data;
-      })) {
-    pmid_nodes.erase(std::remove(pmid_nodes.begin(), pmid_nodes.end(), remove_pmid.first.data),
-                     pmid_nodes.end());
-    ReplacePmidNodes<DataType>(name, pmid_nodes);
-    return maidsafe_error(CommonErrors::success);
-  }
-  return maidsafe_error(CommonErrors::no_such_element);
+template <typename DataType>
+DataManagerDatabase::HolderSet DataManagerDatabase::InsertIfAbsent(
+    const Identity& name, const std::vector<routing::Address>& pmid_nodes) {
+  return DoInsertIfAbsent(EncodeToString<DataType>(name), pmid_nodes);
 }
 
 template <typename DataType>
-DataManagerDatabase::GetPmidsResult DataManagerDatabase::GetPmids(const Identity& name) {
-  if (!database_)
-    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::db_not_present));
-
-  std::vector<routing::Address> pmid_nodes;
-  std::string query("SELECT PmidNodes FROM DataManagerAccounts WHERE ChunkName = ?");
-  sqlite::Statement statement{*database_, query};
-  statement.BindText(1, EncodeToString<DataType>(name));
-
-  if (statement.Step() == sqlite::StepResult::kSqliteRow) {
-    assert(statement.ColumnText(0).size() % identity_size == 0);
-    size_t pmids_count(statement.ColumnText(0).size() / identity_size);
-    for (size_t index(0); index < pmids_count; ++index)
-      pmid_nodes.emplace_back(statement.ColumnText(0).substr(index * identity_size, identity_size));
-  } else {
-    return boost::make_unexpected(MakeError(VaultErrors::no_such_account));
-  }
-  return pmid_nodes;
+DataManagerDatabase::UpdateResult DataManagerDatabase::AddHolders(
+    const Identity& name, const std::vector<routing::Address>& pmid_nodes) {
+  return DoAddHolders(EncodeToString<DataType>(name), pmid_nodes);
 }
 
 template <typename DataType>
-bool DataManagerDatabase::Exist(const Identity& name) {
-  if (!database_)
-    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::db_not_present));
-
-  std::string query("SELECT Count(*) FROM DataManagerAccounts WHERE ChunkName = ?");
-  sqlite::Statement statement{*database_, query};
-  statement.BindText(1, EncodeToString<DataType>(name));
-
-  if (statement.Step() == sqlite::StepResult::kSqliteRow) {
-    auto count(std::stoul(statement.ColumnText(0)));
-    assert(count <= 1);
-    return (count > 0);
-  }
-  return false;
+DataManagerDatabase::UpdateResult DataManagerDatabase::RemoveHolder(
+    const Identity& name, const routing::Address& pmid_node) {
+  return DoRemoveHolder(EncodeToString<DataType>(name), pmid_node);
+}
+
+template <typename DataType>
+DataManagerDatabase::GetPmidsResult DataManagerDatabase::GetPmids(const Identity& name) {
+  return DoGetPmids(EncodeToString<DataType>(name));
 }
 
 }  // namespace vault
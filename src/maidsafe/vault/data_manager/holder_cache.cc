@@ -0,0 +1,103 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/vault/data_manager/holder_cache.h"
+
+#include <functional>
+
+namespace maidsafe {
+
+namespace vault {
+
+HolderCache::HolderCache(std::size_t capacity)
+    : kShardCapacity_(capacity == 0 ? 0 : (capacity + kShardCount_ - 1) / kShardCount_),
+      shards_(),
+      hits_(0),
+      misses_(0) {}
+
+HolderCache::Shard& HolderCache::ShardFor(const std::string& chunk_name) {
+  return shards_[std::hash<std::string>()(chunk_name) % kShardCount_];
+}
+
+HolderCache::EntryList::iterator HolderCache::Find(Shard& shard, const std::string& chunk_name) {
+  auto itr(shard.index.find(chunk_name));
+  if (itr == shard.index.end()) {
+    ++misses_;
+    return shard.entries.end();
+  }
+  ++hits_;
+  shard.entries.splice(shard.entries.begin(), shard.entries, itr->second);
+  return itr->second;
+}
+
+boost::optional<HolderCache::Holders> HolderCache::Get(const std::string& chunk_name) {
+  Shard& shard(ShardFor(chunk_name));
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto itr(Find(shard, chunk_name));
+  if (itr == shard.entries.end())
+    return boost::none;
+  return itr->holders;
+}
+
+bool HolderCache::Contains(const std::string& chunk_name) {
+  Shard& shard(ShardFor(chunk_name));
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  return Find(shard, chunk_name) != shard.entries.end();
+}
+
+void HolderCache::Put(const std::string& chunk_name, const Holders& holders) {
+  if (kShardCapacity_ == 0)
+    return;
+  Shard& shard(ShardFor(chunk_name));
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto itr(shard.index.find(chunk_name));
+  if (itr != shard.index.end()) {
+    itr->second->holders = holders;
+    shard.entries.splice(shard.entries.begin(), shard.entries, itr->second);
+    return;
+  }
+  if (shard.entries.size() == kShardCapacity_) {
+    shard.index.erase(shard.entries.back().chunk_name);
+    shard.entries.pop_back();
+  }
+  shard.entries.push_front(Entry{chunk_name, holders});
+  shard.index.emplace(chunk_name, shard.entries.begin());
+}
+
+void HolderCache::Erase(const std::string& chunk_name) {
+  Shard& shard(ShardFor(chunk_name));
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto itr(shard.index.find(chunk_name));
+  if (itr == shard.index.end())
+    return;
+  shard.entries.erase(itr->second);
+  shard.index.erase(itr);
+}
+
+std::size_t HolderCache::Size() const {
+  std::size_t size(0);
+  for (const auto& shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    size += shard.entries.size();
+  }
+  return size;
+}
+
+}  // namespace vault
+
+}  // namespace maidsafe
@@ -0,0 +1,94 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_VAULT_DATA_MANAGER_HOLDER_CACHE_H_
+#define MAIDSAFE_VAULT_DATA_MANAGER_HOLDER_CACHE_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "boost/optional/optional.hpp"
+
+#include "maidsafe/routing/types.h"
+
+namespace maidsafe {
+
+namespace vault {
+
+// Bounded map of chunk name to holders, kept in front of the DataManager's database so that hot
+// chunks are routed without a query.  Entries are spread over independently locked shards, each
+// evicting its least recently used entry once full, so that concurrent lookups rarely contend.
+// The cache doesn't keep itself coherent with the database; its owner must update it on writes.
+class HolderCache {
+ public:
+  using Holders = std::vector<routing::Address>;
+
+  // A 'capacity' of zero disables the cache.
+  explicit HolderCache(std::size_t capacity);
+  HolderCache(const HolderCache&) = delete;
+  HolderCache(HolderCache&&) = delete;
+  HolderCache& operator=(const HolderCache&) = delete;
+  HolderCache& operator=(HolderCache&&) = delete;
+
+  // Both lookups count towards the hit rate, and refresh the entry found.
+  boost::optional<Holders> Get(const std::string& chunk_name);
+  bool Contains(const std::string& chunk_name);
+  void Put(const std::string& chunk_name, const Holders& holders);
+  void Erase(const std::string& chunk_name);
+
+  std::uint64_t Hits() const { return hits_; }
+  std::uint64_t Misses() const { return misses_; }
+  std::size_t Size() const;
+
+ private:
+  struct Entry {
+    std::string chunk_name;
+    Holders holders;
+  };
+
+  using EntryList = std::list<Entry>;
+
+  struct Shard {
+    Shard() : mutex(), entries(), index() {}
+    mutable std::mutex mutex;
+    // Most recently used first.
+    EntryList entries;
+    std::unordered_map<std::string, EntryList::iterator> index;
+  };
+
+  Shard& ShardFor(const std::string& chunk_name);
+  // Looks up and refreshes an entry, recording a hit or miss.  'shard.mutex' must be held.
+  EntryList::iterator Find(Shard& shard, const std::string& chunk_name);
+
+  static const std::size_t kShardCount_ = 16;
+  const std::size_t kShardCapacity_;
+  std::array<Shard, kShardCount_> shards_;
+  std::atomic<std::uint64_t> hits_, misses_;
+};
+
+}  // namespace vault
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_VAULT_DATA_MANAGER_HOLDER_CACHE_H_
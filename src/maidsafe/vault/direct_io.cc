@@ -0,0 +1,290 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/vault/direct_io.h"
+
+#ifdef MAIDSAFE_WIN32
+#include "maidsafe/common/utils.h"
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#endif
+
+#include "maidsafe/common/log.h"
+
+namespace maidsafe {
+
+namespace vault {
+
+#ifdef MAIDSAFE_WIN32
+
+bool WriteFileUncached(const boost::filesystem::path& path, const std::vector<byte>& content) {
+  return WriteFile(path, content);
+}
+
+boost::optional<std::vector<byte>> ReadFileUncached(const boost::filesystem::path& path,
+                                                    std::uint64_t /*min_size*/) {
+  auto content(ReadFile(path));
+  if (!content)
+    return boost::none;
+  return std::move(*content);
+}
+
+#else
+
+namespace {
+
+// O_DIRECT transfers must be aligned to the device's logical block size in memory, in the file and
+// in length.  This covers 512 byte and 4KiB sectors.
+const std::size_t kAlignment(4096);
+// Larger files are transferred in pieces of this size.
+const std::size_t kMaxTransferSize(1 << 20);
+const std::size_t kMinBufferSize(64 * 1024);
+// Buffers released while the pool holds this much are freed instead.
+const std::size_t kMaxPooledBytes(16 << 20);
+
+std::size_t RoundUp(std::size_t size, std::size_t multiple) {
+  return (size + multiple - 1) / multiple * multiple;
+}
+
+class BufferPool {
+ public:
+  BufferPool() : mutex_(), free_buffers_(), pooled_bytes_(0) {}
+  BufferPool(const BufferPool&) = delete;
+  BufferPool& operator=(const BufferPool&) = delete;
+
+  // Returns an aligned buffer of exactly 'size' bytes, which must be a power of two at least
+  // kAlignment, or null if it can't be allocated.
+  byte* Acquire(std::size_t size) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto itr(free_buffers_.find(size));
+      if (itr != free_buffers_.end()) {
+        byte* buffer(itr->second);
+        free_buffers_.erase(itr);
+        pooled_bytes_ -= size;
+        return buffer;
+      }
+    }
+    void* buffer(nullptr);
+    if (posix_memalign(&buffer, kAlignment, size) != 0)
+      return nullptr;
+    return static_cast<byte*>(buffer);
+  }
+
+  void Release(byte* buffer, std::size_t size) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (pooled_bytes_ + size <= kMaxPooledBytes) {
+        free_buffers_.emplace(size, buffer);
+        pooled_bytes_ += size;
+        return;
+      }
+    }
+    std::free(buffer);
+  }
+
+ private:
+  std::mutex mutex_;
+  std::multimap<std::size_t, byte*> free_buffers_;
+  std::size_t pooled_bytes_;
+};
+
+BufferPool& Pool() {
+  // Never destroyed, as it may be used during static destruction.
+  static BufferPool* const pool(new BufferPool);
+  return *pool;
+}
+
+// Holds a pooled buffer large enough to transfer 'transfer_size' bytes at a time.
+class PooledBuffer {
+ public:
+  explicit PooledBuffer(std::size_t transfer_size) : size_(kMinBufferSize), data_(nullptr) {
+    while (size_ < std::min(transfer_size, kMaxTransferSize))
+      size_ <<= 1;
+    data_ = Pool().Acquire(size_);
+  }
+  ~PooledBuffer() {
+    if (data_)
+      Pool().Release(data_, size_);
+  }
+  PooledBuffer(const PooledBuffer&) = delete;
+  PooledBuffer& operator=(const PooledBuffer&) = delete;
+
+  byte* data() const { return data_; }
+  std::size_t size() const { return size_; }
+
+ private:
+  std::size_t size_;
+  byte* data_;
+};
+
+class Descriptor {
+ public:
+  explicit Descriptor(int descriptor) : descriptor_(descriptor) {}
+  ~Descriptor() {
+    if (descriptor_ != -1)
+      ::close(descriptor_);
+  }
+  Descriptor(const Descriptor&) = delete;
+  Descriptor& operator=(const Descriptor&) = delete;
+
+  int get() const { return descriptor_; }
+
+ private:
+  int descriptor_;
+};
+
+// Returns true if the page cache is bypassed for 'descriptor' from now on.
+bool DisablePageCache(int descriptor) {
+#if defined(O_DIRECT)
+  const int flags(::fcntl(descriptor, F_GETFL));
+  return flags != -1 && ::fcntl(descriptor, F_SETFL, flags | O_DIRECT) == 0;
+#elif defined(F_NOCACHE)
+  // Unlike O_DIRECT, this has no alignment requirements, so it's reported as a buffered transfer.
+  ::fcntl(descriptor, F_NOCACHE, 1);
+  return false;
+#else
+  static_cast<void>(descriptor);
+  return false;
+#endif
+}
+
+bool WriteAll(int descriptor, const byte* data, std::size_t size) {
+  while (size != 0) {
+    const ssize_t written(::write(descriptor, data, size));
+    if (written == -1) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    data += written;
+    size -= static_cast<std::size_t>(written);
+  }
+  return true;
+}
+
+// Returns the number of bytes read, which is less than 'size' only at the end of the file, or -1.
+ssize_t ReadAll(int descriptor, byte* data, std::size_t size) {
+  std::size_t total(0);
+  while (total != size) {
+    const ssize_t bytes_read(::read(descriptor, data + total, size - total));
+    if (bytes_read == -1) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    if (bytes_read == 0)
+      break;
+    total += static_cast<std::size_t>(bytes_read);
+  }
+  return static_cast<ssize_t>(total);
+}
+
+bool WriteDirect(int descriptor, const std::vector<byte>& content) {
+  PooledBuffer buffer(RoundUp(content.size(), kAlignment));
+  if (!buffer.data())
+    return false;
+  for (std::size_t offset(0); offset < content.size(); offset += buffer.size()) {
+    const std::size_t size(std::min(buffer.size(), content.size() - offset));
+    std::memcpy(buffer.data(), content.data() + offset, size);
+    // The final piece is padded out to the alignment and the file truncated afterwards.
+    const std::size_t padded_size(RoundUp(size, kAlignment));
+    std::memset(buffer.data() + size, 0, padded_size - size);
+    if (!WriteAll(descriptor, buffer.data(), padded_size))
+      return false;
+  }
+  return ::ftruncate(descriptor, static_cast<off_t>(content.size())) == 0;
+}
+
+bool ReadDirect(int descriptor, std::vector<byte>& content) {
+  PooledBuffer buffer(RoundUp(content.size(), kAlignment));
+  if (!buffer.data())
+    return false;
+  std::size_t total(0);
+  for (;;) {
+    const ssize_t bytes_read(ReadAll(descriptor, buffer.data(), buffer.size()));
+    if (bytes_read == -1)
+      return false;
+    const std::size_t size(static_cast<std::size_t>(bytes_read));
+    if (total + size > content.size())
+      content.resize(total + size);
+    std::memcpy(content.data() + total, buffer.data(), size);
+    total += size;
+    if (size != buffer.size())
+      break;
+  }
+  content.resize(total);
+  return true;
+}
+
+}  // unnamed namespace
+
+bool WriteFileUncached(const boost::filesystem::path& path, const std::vector<byte>& content) {
+  Descriptor descriptor(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666));
+  if (descriptor.get() == -1) {
+    LOG(kError) << "Failed to open " << path << " for writing: " << std::strerror(errno);
+    return false;
+  }
+  const bool written(DisablePageCache(descriptor.get())
+                         ? WriteDirect(descriptor.get(), content)
+                         : WriteAll(descriptor.get(), content.data(), content.size()));
+  if (!written)
+    LOG(kError) << "Failed to write " << path << ": " << std::strerror(errno);
+  return written;
+}
+
+boost::optional<std::vector<byte>> ReadFileUncached(const boost::filesystem::path& path,
+                                                    std::uint64_t min_size) {
+  Descriptor descriptor(::open(path.c_str(), O_RDONLY));
+  if (descriptor.get() == -1)
+    return boost::none;
+  struct stat status;
+  if (::fstat(descriptor.get(), &status) != 0)
+    return boost::none;
+  std::vector<byte> content(static_cast<std::size_t>(status.st_size));
+  bool succeeded(false);
+  if (static_cast<std::uint64_t>(status.st_size) >= min_size &&
+      DisablePageCache(descriptor.get())) {
+    succeeded = ReadDirect(descriptor.get(), content);
+  } else {
+    const ssize_t bytes_read(ReadAll(descriptor.get(), content.data(), content.size()));
+    succeeded = bytes_read != -1;
+    if (succeeded)
+      content.resize(static_cast<std::size_t>(bytes_read));
+  }
+  if (!succeeded) {
+    LOG(kError) << "Failed to read " << path << ": " << std::strerror(errno);
+    return boost::none;
+  }
+  return content;
+}
+
+#endif
+
+}  // namespace vault
+
+}  // namespace maidsafe
@@ -0,0 +1,50 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_VAULT_DIRECT_IO_H_
+#define MAIDSAFE_VAULT_DIRECT_IO_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "boost/filesystem/path.hpp"
+#include "boost/optional/optional.hpp"
+
+#include "maidsafe/common/types.h"
+
+namespace maidsafe {
+
+namespace vault {
+
+// Whole-file reads and writes which bypass the OS page cache, so that bulk transfers don't evict
+// pages in use by everything else on the host.  This uses O_DIRECT where available, through
+// aligned buffers drawn from a shared pool, or F_NOCACHE on OS X.  Elsewhere, or if the
+// filesystem rejects O_DIRECT, the files are accessed through the page cache as usual.
+
+bool WriteFileUncached(const boost::filesystem::path& path, const std::vector<byte>& content);
+
+// Files smaller than 'min_size' are read through the page cache.  Returns none if the file can't
+// be read.
+boost::optional<std::vector<byte>> ReadFileUncached(const boost::filesystem::path& path,
+                                                    std::uint64_t min_size = 0);
+
+}  // namespace vault
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_VAULT_DIRECT_IO_H_
@@ -0,0 +1,82 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/vault/file_sync.h"
+
+#ifdef MAIDSAFE_WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "maidsafe/common/log.h"
+
+namespace maidsafe {
+
+namespace vault {
+
+namespace {
+
+#ifndef MAIDSAFE_WIN32
+bool Sync(const boost::filesystem::path& path, int flags) {
+  int descriptor(::open(path.c_str(), flags));
+  if (descriptor == -1) {
+    LOG(kError) << "Failed to open " << path << " for syncing.";
+    return false;
+  }
+  bool synced(::fsync(descriptor) == 0);
+  if (!synced)
+    LOG(kError) << "Failed to sync " << path;
+  ::close(descriptor);
+  return synced;
+}
+#endif
+
+}  // unnamed namespace
+
+bool SyncFile(const boost::filesystem::path& path) {
+#ifdef MAIDSAFE_WIN32
+  HANDLE handle(CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr));
+  if (handle == INVALID_HANDLE_VALUE) {
+    LOG(kError) << "Failed to open " << path << " for syncing.";
+    return false;
+  }
+  bool synced(FlushFileBuffers(handle) != 0);
+  if (!synced)
+    LOG(kError) << "Failed to sync " << path;
+  CloseHandle(handle);
+  return synced;
+#else
+  return Sync(path, O_RDWR);
+#endif
+}
+
+bool SyncDirectory(const boost::filesystem::path& path) {
+#ifdef MAIDSAFE_WIN32
+  static_cast<void>(path);
+  return true;
+#else
+  return Sync(path, O_RDONLY);
+#endif
+}
+
+}  // namespace vault
+
+}  // namespace maidsafe
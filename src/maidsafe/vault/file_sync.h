@@ -0,0 +1,39 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_VAULT_FILE_SYNC_H_
+#define MAIDSAFE_VAULT_FILE_SYNC_H_
+
+#include "boost/filesystem/path.hpp"
+
+namespace maidsafe {
+
+namespace vault {
+
+// Flushes the file's data and metadata to stable storage.
+bool SyncFile(const boost::filesystem::path& path);
+
+// Makes the creation, renaming or removal of entries within 'path' durable.  This is a no-op on
+// Windows, where directory entries can't be synced independently.
+bool SyncDirectory(const boost::filesystem::path& path);
+
+}  // namespace vault
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_VAULT_FILE_SYNC_H_
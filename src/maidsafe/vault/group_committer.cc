@@ -0,0 +1,95 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/vault/group_committer.h"
+
+#include "maidsafe/vault/file_sync.h"
+
+namespace maidsafe {
+
+namespace vault {
+
+GroupCommitter::GroupCommitter(std::chrono::milliseconds window, std::size_t max_batch_size,
+                               std::function<bool()> flush)
+    : kWindow_(window),
+      kMaxBatchSize_(max_batch_size == 0 ? 1 : max_batch_size),
+      kFlush_(std::move(flush)),
+      mutex_(),
+      pending_condition_(),
+      complete_condition_(),
+      pending_(std::make_shared<Batch>()),
+      stopping_(false),
+      thread_([this] { Run(); }) {}
+
+GroupCommitter::~GroupCommitter() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  pending_condition_.notify_one();
+  thread_.join();
+}
+
+bool GroupCommitter::Sync(const boost::filesystem::path& file,
+                          const boost::filesystem::path& directory) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  std::shared_ptr<Batch> batch(pending_);
+  if (!file.empty())
+    batch->files.insert(file);
+  if (!directory.empty())
+    batch->directories.insert(directory);
+  if (++batch->size == 1 || batch->size == kMaxBatchSize_)
+    pending_condition_.notify_one();
+  complete_condition_.wait(lock, [&] { return batch->complete; });
+  return batch->flushed && batch->failed.count(file) == 0 &&
+         batch->failed.count(directory) == 0;
+}
+
+void GroupCommitter::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    pending_condition_.wait(lock, [&] { return stopping_ || pending_->size != 0; });
+    if (pending_->size == 0)
+      return;
+    // Give other writers until the end of the window to join the batch.
+    pending_condition_.wait_for(lock, kWindow_,
+                                [&] { return stopping_ || pending_->size >= kMaxBatchSize_; });
+    std::shared_ptr<Batch> batch(pending_);
+    pending_ = std::make_shared<Batch>();
+    lock.unlock();
+
+    batch->flushed = !kFlush_ || kFlush_();
+    // File contents are synced before the directories naming them.
+    for (const auto& file : batch->files) {
+      if (!SyncFile(file))
+        batch->failed.insert(file);
+    }
+    for (const auto& directory : batch->directories) {
+      if (!SyncDirectory(directory))
+        batch->failed.insert(directory);
+    }
+
+    lock.lock();
+    batch->complete = true;
+    complete_condition_.notify_all();
+  }
+}
+
+}  // namespace vault
+
+}  // namespace maidsafe
@@ -0,0 +1,81 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_VAULT_GROUP_COMMITTER_H_
+#define MAIDSAFE_VAULT_GROUP_COMMITTER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include "boost/filesystem/path.hpp"
+
+namespace maidsafe {
+
+namespace vault {
+
+// Shares the cost of making writes durable between concurrent writers.  Each caller of Sync joins
+// the open batch and blocks until a background thread has flushed it.  A batch is flushed once it
+// has been open for 'window' or holds 'max_batch_size' requests, and each distinct path in it is
+// synced only once.
+class GroupCommitter {
+ public:
+  // 'flush', if set, is additionally called once per batch, and its failure fails every request in
+  // the batch.
+  GroupCommitter(std::chrono::milliseconds window, std::size_t max_batch_size,
+                 std::function<bool()> flush = nullptr);
+  ~GroupCommitter();
+  GroupCommitter(const GroupCommitter&) = delete;
+  GroupCommitter(GroupCommitter&&) = delete;
+  GroupCommitter& operator=(const GroupCommitter&) = delete;
+  GroupCommitter& operator=(GroupCommitter&&) = delete;
+
+  // Blocks until 'file' and the entries of 'directory' have been synced; either may be empty.
+  // Returns false if anything required couldn't be synced.
+  bool Sync(const boost::filesystem::path& file, const boost::filesystem::path& directory);
+
+ private:
+  struct Batch {
+    Batch() : files(), directories(), failed(), size(0), flushed(false), complete(false) {}
+    std::set<boost::filesystem::path> files, directories, failed;
+    std::size_t size;
+    bool flushed, complete;
+  };
+
+  void Run();
+
+  const std::chrono::milliseconds kWindow_;
+  const std::size_t kMaxBatchSize_;
+  const std::function<bool()> kFlush_;
+  std::mutex mutex_;
+  std::condition_variable pending_condition_, complete_condition_;
+  std::shared_ptr<Batch> pending_;
+  bool stopping_;
+  std::thread thread_;
+};
+
+}  // namespace vault
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_VAULT_GROUP_COMMITTER_H_
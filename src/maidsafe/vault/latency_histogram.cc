@@ -0,0 +1,109 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/vault/latency_histogram.h"
+
+#include <algorithm>
+
+namespace maidsafe {
+
+namespace vault {
+
+namespace {
+
+std::uint32_t FloorLog2(std::uint64_t value) {
+  std::uint32_t result(0);
+  for (std::uint32_t shift(32); shift != 0; shift >>= 1) {
+    if (value >> shift) {
+      value >>= shift;
+      result += shift;
+    }
+  }
+  return result;
+}
+
+}  // unnamed namespace
+
+LatencyHistogram::LatencyHistogram() : buckets_(), count_(0), total_(0), max_(0) {
+  for (auto& bucket : buckets_)
+    bucket.store(0, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::Record(std::chrono::nanoseconds duration) {
+  const std::uint64_t value(duration.count() > 0 ? static_cast<std::uint64_t>(duration.count())
+                                                 : 0);
+  buckets_[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  total_.fetch_add(value, std::memory_order_relaxed);
+  std::uint64_t max(max_.load(std::memory_order_relaxed));
+  while (value > max && !max_.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+  }
+}
+
+LatencyHistogram::Summary LatencyHistogram::Summarise() const {
+  std::array<std::uint64_t, kBucketCount_> counts;
+  std::uint64_t count(0);
+  for (std::size_t i(0); i != kBucketCount_; ++i) {
+    counts[i] = buckets_[i].load(std::memory_order_relaxed);
+    count += counts[i];
+  }
+  Summary summary{count, std::chrono::nanoseconds(total_.load(std::memory_order_relaxed)),
+                  std::chrono::nanoseconds(0), std::chrono::nanoseconds(0),
+                  std::chrono::nanoseconds(0), std::chrono::nanoseconds(0),
+                  std::chrono::nanoseconds(max_.load(std::memory_order_relaxed))};
+  if (count == 0)
+    return summary;
+  summary.mean = summary.total / count;
+  const std::array<std::pair<double, std::chrono::nanoseconds*>, 3> percentiles{
+      {{0.5, &summary.p50}, {0.9, &summary.p90}, {0.99, &summary.p99}}};
+  std::uint64_t seen(0);
+  std::size_t next(0);
+  for (std::size_t i(0); i != kBucketCount_ && next != percentiles.size(); ++i) {
+    seen += counts[i];
+    while (next != percentiles.size() && seen >= percentiles[next].first * count) {
+      // The bucket's midpoint may exceed the largest duration actually recorded.
+      *percentiles[next].second =
+          std::min(std::chrono::nanoseconds(BucketValue(i)), summary.max);
+      ++next;
+    }
+  }
+  return summary;
+}
+
+std::size_t LatencyHistogram::BucketIndex(std::uint64_t value) {
+  if (value < kSubBucketCount_)
+    return static_cast<std::size_t>(value);
+  const std::uint32_t exponent(FloorLog2(value));
+  if (exponent >= kMaxExponent_)
+    return kBucketCount_ - 1;
+  const std::uint32_t shift(exponent - kSubBucketBits_);
+  const std::uint64_t sub_bucket((value >> shift) & (kSubBucketCount_ - 1));
+  return static_cast<std::size_t>((shift + 1) * kSubBucketCount_ + sub_bucket);
+}
+
+std::uint64_t LatencyHistogram::BucketValue(std::size_t index) {
+  if (index < kSubBucketCount_)
+    return index;
+  const std::uint64_t shift(index / kSubBucketCount_ - 1);
+  const std::uint64_t lower((kSubBucketCount_ + index % kSubBucketCount_) << shift);
+  return lower + ((std::uint64_t(1) << shift) >> 1);
+}
+
+}  // namespace vault
+
+}  // namespace maidsafe
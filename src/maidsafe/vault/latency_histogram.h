@@ -0,0 +1,71 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_VAULT_LATENCY_HISTOGRAM_H_
+#define MAIDSAFE_VAULT_LATENCY_HISTOGRAM_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace maidsafe {
+
+namespace vault {
+
+// Log-linear histogram of durations in the style of HdrHistogram, safe for concurrent use.  Each
+// power of two is split into eight buckets, so reported percentiles are within 12.5% of the true
+// values.  Recording is a handful of relaxed atomic increments, and durations beyond about 18
+// minutes are counted in the last bucket.
+class LatencyHistogram {
+ public:
+  struct Summary {
+    std::uint64_t count;
+    std::chrono::nanoseconds total, mean, p50, p90, p99, max;
+  };
+
+  LatencyHistogram();
+  LatencyHistogram(const LatencyHistogram&) = delete;
+  LatencyHistogram(LatencyHistogram&&) = delete;
+  LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+  LatencyHistogram& operator=(LatencyHistogram&&) = delete;
+
+  void Record(std::chrono::nanoseconds duration);
+  // Concurrent recording may leave the summary slightly inconsistent, but never invalid.
+  Summary Summarise() const;
+
+ private:
+  static const std::uint32_t kSubBucketBits_ = 3;
+  static const std::uint32_t kSubBucketCount_ = 1 << kSubBucketBits_;
+  static const std::uint32_t kMaxExponent_ = 40;
+  static const std::size_t kBucketCount_ =
+      (kMaxExponent_ - kSubBucketBits_ + 1) * kSubBucketCount_;
+
+  static std::size_t BucketIndex(std::uint64_t value);
+  // A representative value for durations counted in the bucket: the middle of its range.
+  static std::uint64_t BucketValue(std::size_t index);
+
+  std::array<std::atomic<std::uint64_t>, kBucketCount_> buckets_;
+  std::atomic<std::uint64_t> count_, total_, max_;
+};
+
+}  // namespace vault
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_VAULT_LATENCY_HISTOGRAM_H_
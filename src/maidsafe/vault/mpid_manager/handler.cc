@@ -24,9 +24,25 @@ namespace maidsafe {
 
 namespace vault {
 
+namespace {
+
+// Account chunks are read on every message, so are worth keeping decrypted in memory.
+const std::uint64_t kChunkCacheCapacity(16 * 1024 * 1024);
+
+ChunkStore::Options ChunkStoreOptions() {
+  ChunkStore::Options options;
+  options.cache_capacity = kChunkCacheCapacity;
+  // Message bodies are signed text, so usually compress well.
+  options.compression = true;
+  return options;
+}
+
+}  // unnamed namespace
+
 MpidManagerHandler::MpidManagerHandler(const boost::filesystem::path& vault_root_dir,
                                        DiskUsage max_disk_usage)
-    : chunk_store_(vault_root_dir / "mpid_manager" / "permanent", max_disk_usage),
+    : chunk_store_(vault_root_dir / "mpid_manager" / "permanent", max_disk_usage,
+                   ChunkStoreOptions()),
       db_() {}
 
 void MpidManagerHandler::Put(const ImmutableData& data, const MpidName& mpid) {
@@ -47,9 +63,7 @@ bool MpidManagerHandler::Has(const MessageIdType& message_id) {
 bool MpidManagerHandler::HasAccount(const MpidName& mpid) {
   try {
     Identity account_name(db_.GetAccountChunkName(mpid));
-    Data::NameAndTypeId key(account_name, DataTypeId(0));
-    NonEmptyString result(chunk_store_.Get(key));
-    return result.IsInitialised();
+    return chunk_store_.Has(Data::NameAndTypeId(account_name, DataTypeId(0)));
   }
   catch (...) {
     return false;
@@ -0,0 +1,62 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/vault/open_roots.h"
+
+#include <map>
+#include <mutex>
+
+#include "boost/filesystem/operations.hpp"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+
+namespace vault {
+
+namespace {
+
+std::mutex open_roots_mutex;
+std::map<fs::path, int> open_roots;
+
+}  // unnamed namespace
+
+void RegisterOpenRoot(const fs::path& disk_root) {
+  std::lock_guard<std::mutex> lock(open_roots_mutex);
+  ++open_roots[fs::absolute(disk_root)];
+}
+
+bool RegisterExclusiveRoot(const fs::path& disk_root) {
+  std::lock_guard<std::mutex> lock(open_roots_mutex);
+  return open_roots.emplace(fs::absolute(disk_root), 1).second;
+}
+
+bool UnregisterOpenRoot(const fs::path& disk_root) {
+  std::lock_guard<std::mutex> lock(open_roots_mutex);
+  auto itr(open_roots.find(fs::absolute(disk_root)));
+  if (itr == open_roots.end())
+    return false;
+  if (--itr->second != 0)
+    return false;
+  open_roots.erase(itr);
+  return true;
+}
+
+}  // namespace vault
+
+}  // namespace maidsafe
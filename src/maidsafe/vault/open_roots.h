@@ -0,0 +1,43 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_VAULT_OPEN_ROOTS_H_
+#define MAIDSAFE_VAULT_OPEN_ROOTS_H_
+
+#include "boost/filesystem/path.hpp"
+
+namespace maidsafe {
+
+namespace vault {
+
+// Tracks how many stores in this process are open on each disk root.
+
+void RegisterOpenRoot(const boost::filesystem::path& disk_root);
+
+// As above, but fails if any store already has 'disk_root' open.  For stores which can't share
+// their root, even with another instance in the same process.
+bool RegisterExclusiveRoot(const boost::filesystem::path& disk_root);
+
+// Returns true if this was the last store open on 'disk_root'.
+bool UnregisterOpenRoot(const boost::filesystem::path& disk_root);
+
+}  // namespace vault
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_VAULT_OPEN_ROOTS_H_
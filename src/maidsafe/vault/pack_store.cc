@@ -0,0 +1,583 @@
+/*  Copyright 2013 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/vault/pack_store.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <iterator>
+#include <limits>
+#include <sstream>
+
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/log.h"
+
+#include "maidsafe/vault/file_sync.h"
+#include "maidsafe/vault/open_roots.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+
+namespace vault {
+
+namespace {
+
+// Each record is laid out as: magic (4) | kind (1) | key size (1) | value size (4) | key | value
+const std::uint32_t kRecordMagic(0x4d53504b);
+const std::uint32_t kRecordHeaderSize(10);
+const char kLiveRecord(0), kTombstone(1);
+
+struct RecordHeader {
+  RecordHeader() : kind(kLiveRecord), key_size(0), value_size(0) {}
+  char kind;
+  std::uint8_t key_size;
+  std::uint32_t value_size;
+};
+
+void PutUint32(std::uint32_t value, char* output) {
+  for (int i(3); i >= 0; --i) {
+    output[i] = static_cast<char>(value & 0xff);
+    value >>= 8;
+  }
+}
+
+std::uint32_t GetUint32(const char* input) {
+  std::uint32_t value(0);
+  for (int i(0); i != 4; ++i)
+    value = (value << 8) | static_cast<unsigned char>(input[i]);
+  return value;
+}
+
+std::string EncodeHeader(const RecordHeader& header) {
+  std::string encoded(kRecordHeaderSize, 0);
+  PutUint32(kRecordMagic, &encoded[0]);
+  encoded[4] = header.kind;
+  encoded[5] = static_cast<char>(header.key_size);
+  PutUint32(header.value_size, &encoded[6]);
+  return encoded;
+}
+
+// Returns false at a clean end of file, throws if a partial or corrupt header is found.
+bool ReadHeader(std::istream& input, RecordHeader& header) {
+  char encoded[kRecordHeaderSize];
+  input.read(encoded, kRecordHeaderSize);
+  if (input.gcount() == 0 && input.eof())
+    return false;
+  if (input.gcount() != kRecordHeaderSize || GetUint32(encoded) != kRecordMagic ||
+      (encoded[4] != kLiveRecord && encoded[4] != kTombstone)) {
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::parsing_error));
+  }
+  header.kind = encoded[4];
+  header.key_size = static_cast<std::uint8_t>(encoded[5]);
+  header.value_size = GetUint32(&encoded[6]);
+  return true;
+}
+
+std::uint64_t RecordSize(std::size_t key_size, std::uint64_t value_size) {
+  return kRecordHeaderSize + key_size + value_size;
+}
+
+fs::path SegmentPath(const fs::path& root, std::uint32_t id) {
+  std::ostringstream file_name;
+  file_name << "segment_" << std::setw(8) << std::setfill('0') << id << ".pack";
+  return root / file_name.str();
+}
+
+bool ParseSegmentId(const fs::path& path, std::uint32_t& id) {
+  const std::string file_name(path.filename().string());
+  if (file_name.size() != 21 || file_name.compare(0, 8, "segment_") != 0 ||
+      path.extension() != ".pack") {
+    return false;
+  }
+  try {
+    id = static_cast<std::uint32_t>(std::stoul(file_name.substr(8, 8)));
+    return true;
+  } catch (const std::exception&) {
+    return false;
+  }
+}
+
+}  // unnamed namespace
+
+PackStore::Segment::Segment(fs::path path_in, std::uint32_t id_in)
+    : path(std::move(path_in)),
+      id(id_in),
+      size(0),
+      dead_bytes(0),
+      retired(false),
+      quarantined(false) {}
+
+PackStore::Segment::~Segment() {
+  if (retired) {
+    boost::system::error_code error_code;
+    if (!fs::remove(path, error_code) || error_code)
+      LOG(kWarning) << "Failed to remove compacted segment " << path << ": "
+                    << error_code.message();
+  }
+}
+
+PackStore::PackStore(const fs::path& root, std::uint64_t max_segment_size)
+    : kRoot_(root),
+      kMaxSegmentSize_(max_segment_size),
+      mutex_(),
+      compaction_mutex_(),
+      index_(),
+      segments_(),
+      active_segment_(),
+      active_stream_(),
+      live_bytes_(0),
+      disk_bytes_(0),
+      on_reclaimed_(),
+      unsynced_segment_id_(0),
+      compaction_condition_(),
+      compaction_pending_(false),
+      stop_compaction_(false),
+      compaction_thread_() {
+  // A second instance would replay, append to and compact the same segments independently.
+  if (!RegisterExclusiveRoot(kRoot_)) {
+    LOG(kError) << "Pack store at " << kRoot_ << " is already open.";
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::unable_to_handle_request));
+  }
+  try {
+    Open();
+  } catch (const std::exception&) {
+    UnregisterOpenRoot(kRoot_);
+    throw;
+  }
+  compaction_pending_ = static_cast<bool>(NextCompactionCandidate());
+  compaction_thread_ = std::thread([this] { CompactionLoop(); });
+}
+
+PackStore::~PackStore() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_compaction_ = true;
+  }
+  compaction_condition_.notify_one();
+  compaction_thread_.join();
+  UnregisterOpenRoot(kRoot_);
+}
+
+void PackStore::Open() {
+  boost::system::error_code error_code;
+  if (!fs::exists(kRoot_, error_code) && !fs::create_directories(kRoot_, error_code)) {
+    LOG(kError) << "Can't create pack store root at " << kRoot_ << ": " << error_code.message();
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::uninitialised));
+  }
+  if (!fs::is_directory(kRoot_, error_code))
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::not_a_directory));
+
+  for (fs::directory_iterator itr(kRoot_); itr != fs::directory_iterator(); ++itr) {
+    std::uint32_t id(0);
+    if (fs::is_regular_file(itr->status()) && ParseSegmentId(itr->path(), id))
+      segments_.emplace(id, std::make_shared<Segment>(itr->path(), id));
+  }
+  // Segments must be replayed oldest first so that later records supersede earlier ones.
+  for (auto itr(segments_.begin()); itr != segments_.end(); ++itr)
+    Replay(itr->second, std::next(itr) == segments_.end());
+
+  if (!segments_.empty() && segments_.rbegin()->second->size < kMaxSegmentSize_) {
+    active_segment_ = segments_.rbegin()->second;
+    active_stream_.open(active_segment_->path.string(), std::ios::binary | std::ios::app);
+    if (!active_stream_)
+      BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+  } else {
+    OpenNewSegment();
+  }
+}
+
+void PackStore::Put(const NameType& name, const std::vector<byte>& content) {
+  const std::string key(Key(name));
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::uint64_t offset(Append(key, false, content));
+  auto itr(index_.find(key));
+  if (itr != index_.end()) {
+    itr->second.segment->dead_bytes += RecordSize(key.size(), itr->second.length);
+    live_bytes_ -= itr->second.length;
+    itr->second = Location{active_segment_, offset, static_cast<std::uint32_t>(content.size())};
+  } else {
+    index_.emplace(key,
+                   Location{active_segment_, offset, static_cast<std::uint32_t>(content.size())});
+  }
+  live_bytes_ += content.size();
+  if (!compaction_pending_ && NextCompactionCandidate()) {
+    compaction_pending_ = true;
+    compaction_condition_.notify_one();
+  }
+}
+
+boost::optional<std::uint64_t> PackStore::Delete(const NameType& name) {
+  const std::string key(Key(name));
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto itr(index_.find(key));
+  if (itr == index_.end())
+    return boost::none;
+  Append(key, true, std::vector<byte>());
+  active_segment_->dead_bytes += RecordSize(key.size(), 0);
+  std::uint64_t length(itr->second.length);
+  itr->second.segment->dead_bytes += RecordSize(key.size(), length);
+  live_bytes_ -= length;
+  index_.erase(itr);
+  if (!compaction_pending_ && NextCompactionCandidate()) {
+    compaction_pending_ = true;
+    compaction_condition_.notify_one();
+  }
+  return length;
+}
+
+boost::optional<std::vector<byte>> PackStore::Get(const NameType& name) const {
+  return GetRange(name, 0, std::numeric_limits<std::uint64_t>::max());
+}
+
+boost::optional<std::vector<byte>> PackStore::GetRange(const NameType& name, std::uint64_t offset,
+                                                       std::uint64_t length) const {
+  Location location;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto itr(index_.find(Key(name)));
+    if (itr == index_.end())
+      return boost::none;
+    location = itr->second;
+  }
+  offset = std::min<std::uint64_t>(offset, location.length);
+  length = std::min<std::uint64_t>(length, location.length - offset);
+  std::vector<byte> content(static_cast<std::size_t>(length));
+  if (length == 0)
+    return content;
+  // The segment can't be removed while 'location' holds it, even if it is compacted meanwhile.
+  std::ifstream input(location.segment->path.string(), std::ios::binary);
+  input.seekg(location.offset + offset);
+  input.read(reinterpret_cast<char*>(content.data()), length);
+  if (!input || static_cast<std::uint64_t>(input.gcount()) != length) {
+    LOG(kError) << "Failed to read " << length << " bytes at " << location.offset + offset
+                << " in " << location.segment->path;
+    return boost::none;
+  }
+  return content;
+}
+
+boost::optional<std::uint64_t> PackStore::Size(const NameType& name) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto itr(index_.find(Key(name)));
+  if (itr == index_.end())
+    return boost::none;
+  return static_cast<std::uint64_t>(itr->second.length);
+}
+
+std::vector<PackStore::NameType> PackStore::Names() const {
+  std::vector<NameType> names;
+  std::lock_guard<std::mutex> lock(mutex_);
+  names.reserve(index_.size());
+  for (const auto& entry : index_)
+    names.push_back(KeyName(entry.first));
+  return names;
+}
+
+void PackStore::VisitNames(const boost::optional<NameType>& first,
+                           const std::function<bool(const NameType&)>& visitor) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto itr(first ? index_.lower_bound(Key(*first)) : index_.begin()); itr != index_.end();
+       ++itr) {
+    if (!visitor(KeyName(itr->first)))
+      return;
+  }
+}
+
+std::uint64_t PackStore::SpaceRequired(const NameType& name, std::uint64_t value_size) {
+  return RecordSize(Key(name).size(), value_size);
+}
+
+std::uint64_t PackStore::LiveBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return live_bytes_;
+}
+
+std::uint64_t PackStore::DiskBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return disk_bytes_;
+}
+
+std::uint64_t PackStore::WatchReclaimed(std::function<void(std::uint64_t)> on_reclaimed) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  on_reclaimed_ = std::move(on_reclaimed);
+  return disk_bytes_;
+}
+
+std::size_t PackStore::SegmentCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return segments_.size();
+}
+
+bool PackStore::Sync() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return DoSync();
+}
+
+void PackStore::Compact() {
+  std::lock_guard<std::mutex> compaction_lock(compaction_mutex_);
+  std::shared_ptr<Segment> segment;
+  for (;;) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      segment = NextCompactionCandidate();
+    }
+    if (!segment)
+      return;
+    CompactSegment(segment);
+  }
+}
+
+std::uint64_t PackStore::Reclaim(std::uint64_t required_space) {
+  std::lock_guard<std::mutex> compaction_lock(compaction_mutex_);
+  std::uint64_t freed(0);
+  while (freed < required_space) {
+    std::shared_ptr<Segment> segment;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (active_segment_->dead_bytes != 0)
+        OpenNewSegment();
+      for (const auto& entry : segments_) {
+        if (entry.second != active_segment_ && !entry.second->quarantined &&
+            entry.second->dead_bytes != 0 &&
+            (!segment || entry.second->dead_bytes > segment->dead_bytes)) {
+          segment = entry.second;
+        }
+      }
+    }
+    if (!segment)
+      break;
+    // Tombstones which still shadow older records are carried forward rather than freed, so stop
+    // once that's all that is left.
+    const std::uint64_t segment_freed(CompactSegment(segment));
+    if (segment_freed == 0)
+      break;
+    freed += segment_freed;
+  }
+  return freed;
+}
+
+std::string PackStore::Key(const NameType& name) {
+  const auto& name_bytes(name.name.string());
+  std::string key(name_bytes.begin(), name_bytes.end());
+  key.resize(key.size() + 4);
+  PutUint32(name.type_id.data, &key[key.size() - 4]);
+  return key;
+}
+
+PackStore::NameType PackStore::KeyName(const std::string& key) {
+  return NameType(Identity(std::vector<byte>(key.begin(), key.end() - 4)),
+                  DataTypeId(GetUint32(&key[key.size() - 4])));
+}
+
+bool PackStore::DoSync() {
+  bool synced(true);
+  // Every segment from the one active at the last sync onwards may hold unsynced records.
+  for (auto itr(segments_.lower_bound(unsynced_segment_id_)); itr != segments_.end(); ++itr)
+    synced = SyncFile(itr->second->path) && synced;
+  synced = SyncDirectory(kRoot_) && synced;
+  if (synced)
+    unsynced_segment_id_ = active_segment_->id;
+  return synced;
+}
+
+void PackStore::Replay(const std::shared_ptr<Segment>& segment, bool newest) {
+  std::ifstream input(segment->path.string(), std::ios::binary);
+  const std::uint64_t file_size(fs::file_size(segment->path));
+  std::uint64_t offset(0);
+  try {
+    RecordHeader header;
+    while (offset < file_size && ReadHeader(input, header)) {
+      std::string key(header.key_size, 0);
+      input.read(&key[0], header.key_size);
+      const std::uint64_t value_offset(offset + kRecordHeaderSize + header.key_size);
+      if (!input || value_offset + header.value_size > file_size)
+        BOOST_THROW_EXCEPTION(MakeError(CommonErrors::parsing_error));
+
+      auto itr(index_.find(key));
+      if (itr != index_.end()) {
+        itr->second.segment->dead_bytes += RecordSize(key.size(), itr->second.length);
+        live_bytes_ -= itr->second.length;
+      }
+      if (header.kind == kLiveRecord) {
+        Location location{segment, value_offset, header.value_size};
+        if (itr != index_.end())
+          itr->second = location;
+        else
+          index_.emplace(key, location);
+        live_bytes_ += header.value_size;
+      } else {
+        segment->dead_bytes += RecordSize(key.size(), 0);
+        if (itr != index_.end())
+          index_.erase(itr);
+      }
+      offset = value_offset + header.value_size;
+      input.seekg(offset);
+    }
+  } catch (const std::exception&) {
+    input.close();
+    if (newest) {
+      // A torn record can only be the last one written before a crash, so drop the tail.
+      LOG(kWarning) << "Truncating " << segment->path << " from " << file_size << " to " << offset
+                    << " bytes after finding an incomplete record.";
+      fs::resize_file(segment->path, offset);
+    } else {
+      // A sealed segment was complete, so this is corruption.  The records before it are still
+      // indexed, but those after it can't be found, so the file is kept as it is for recovery.
+      LOG(kError) << "Quarantining " << segment->path << ", which is corrupt at offset " << offset
+                  << " of " << file_size << " bytes.  The records after that are unavailable.";
+      segment->quarantined = true;
+      offset = file_size;
+    }
+  }
+  segment->size = offset;
+  disk_bytes_ += offset;
+}
+
+void PackStore::OpenNewSegment() {
+  std::uint32_t id(segments_.empty() ? 1 : segments_.rbegin()->first + 1);
+  auto segment(std::make_shared<Segment>(SegmentPath(kRoot_, id), id));
+  if (active_stream_.is_open())
+    active_stream_.close();
+  active_stream_.clear();
+  active_stream_.open(segment->path.string(), std::ios::binary | std::ios::trunc);
+  if (!active_stream_) {
+    LOG(kError) << "Failed to create segment " << segment->path;
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+  }
+  segments_.emplace(id, segment);
+  active_segment_ = segment;
+}
+
+std::uint64_t PackStore::Append(const std::string& key, bool tombstone,
+                                const std::vector<byte>& content) {
+  const std::uint64_t record_size(RecordSize(key.size(), content.size()));
+  if (active_segment_->size != 0 && active_segment_->size + record_size > kMaxSegmentSize_)
+    OpenNewSegment();
+
+  RecordHeader header;
+  header.kind = tombstone ? kTombstone : kLiveRecord;
+  header.key_size = static_cast<std::uint8_t>(key.size());
+  header.value_size = static_cast<std::uint32_t>(content.size());
+  const std::string encoded_header(EncodeHeader(header));
+  active_stream_.write(encoded_header.data(), encoded_header.size());
+  active_stream_.write(key.data(), key.size());
+  active_stream_.write(reinterpret_cast<const char*>(content.data()), content.size());
+  active_stream_.flush();
+  if (!active_stream_) {
+    // Restore the segment to its last good size so the partial record can't be replayed.
+    LOG(kError) << "Failed to append to " << active_segment_->path;
+    active_stream_.close();
+    boost::system::error_code error_code;
+    fs::resize_file(active_segment_->path, active_segment_->size, error_code);
+    active_stream_.clear();
+    active_stream_.open(active_segment_->path.string(), std::ios::binary | std::ios::app);
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+  }
+  const std::uint64_t value_offset(active_segment_->size + kRecordHeaderSize + key.size());
+  active_segment_->size += record_size;
+  disk_bytes_ += record_size;
+  return value_offset;
+}
+
+std::shared_ptr<PackStore::Segment> PackStore::NextCompactionCandidate() const {
+  for (const auto& entry : segments_) {
+    const auto& segment(entry.second);
+    if (segment != active_segment_ && !segment->quarantined &&
+        segment->dead_bytes * 2 >= segment->size) {
+      return segment;
+    }
+  }
+  return nullptr;
+}
+
+std::uint64_t PackStore::CompactSegment(const std::shared_ptr<Segment>& segment) {
+  bool is_oldest(false);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    is_oldest = (segments_.begin()->second == segment);
+  }
+  // The segment is sealed, so it can be read without holding the lock.
+  std::ifstream input(segment->path.string(), std::ios::binary);
+  std::uint64_t offset(0), copied(0);
+  RecordHeader header;
+  while (offset < segment->size && ReadHeader(input, header)) {
+    std::string key(header.key_size, 0);
+    input.read(&key[0], header.key_size);
+    const std::uint64_t value_offset(offset + kRecordHeaderSize + header.key_size);
+    std::vector<byte> content(header.value_size);
+    input.read(reinterpret_cast<char*>(content.data()), header.value_size);
+    if (!input)
+      BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+    offset = value_offset + header.value_size;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto itr(index_.find(key));
+    if (header.kind == kLiveRecord) {
+      if (itr != index_.end() && itr->second.segment == segment &&
+          itr->second.offset == value_offset) {
+        itr->second.offset = Append(key, false, content);
+        itr->second.segment = active_segment_;
+        copied += RecordSize(key.size(), content.size());
+      }
+    } else if (!is_oldest && itr == index_.end()) {
+      // Older segments may still hold a record which this tombstone shadows.
+      Append(key, true, content);
+      active_segment_->dead_bytes += RecordSize(key.size(), 0);
+      copied += RecordSize(key.size(), 0);
+    }
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  // The copies must be durable before the originals can go, or a crash could lose live records or
+  // resurrect ones which the dropped tombstones shadowed.
+  if (!DoSync()) {
+    LOG(kError) << "Failed to sync the compacted records of " << segment->path;
+    BOOST_THROW_EXCEPTION(MakeError(CommonErrors::filesystem_io_error));
+  }
+  segment->retired = true;
+  segments_.erase(segment->id);
+  disk_bytes_ -= segment->size;
+  // The copies were appended without being reserved by the owner, so only the difference is freed.
+  const std::uint64_t freed(segment->size - copied);
+  if (on_reclaimed_ && freed != 0)
+    on_reclaimed_(freed);
+  return freed;
+}
+
+void PackStore::CompactionLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    compaction_condition_.wait(lock, [this] { return stop_compaction_ || compaction_pending_; });
+    if (stop_compaction_)
+      return;
+    compaction_pending_ = false;
+    lock.unlock();
+    try {
+      Compact();
+    } catch (const std::exception& e) {
+      LOG(kError) << "Pack store compaction failed: " << boost::diagnostic_information(e);
+    }
+    lock.lock();
+  }
+}
+
+}  // namespace vault
+
+}  // namespace maidsafe
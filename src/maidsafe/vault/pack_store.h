@@ -0,0 +1,153 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_VAULT_PACK_STORE_H_
+#define MAIDSAFE_VAULT_PACK_STORE_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "boost/filesystem/path.hpp"
+#include "boost/optional/optional.hpp"
+
+#include "maidsafe/common/types.h"
+#include "maidsafe/common/data_types/data.h"
+
+namespace maidsafe {
+
+namespace vault {
+
+// Log-structured chunk storage.  Records are appended to large segment files and located through
+// an in-memory index which is rebuilt by replaying the segment headers on construction.  Deletes
+// append a tombstone, and a background thread compacts segments once enough of their contents are
+// dead.
+class PackStore {
+ public:
+  using NameType = Data::NameAndTypeId;
+
+  // Throws if another PackStore in this process has 'root' open.
+  PackStore(const boost::filesystem::path& root, std::uint64_t max_segment_size = 64 << 20);
+  ~PackStore();
+  PackStore(const PackStore&) = delete;
+  PackStore(PackStore&&) = delete;
+  PackStore& operator=(const PackStore&) = delete;
+  PackStore& operator=(PackStore&&) = delete;
+
+  void Put(const NameType& name, const std::vector<byte>& content);
+  // Returns the size of the removed value, or none if 'name' wasn't stored.
+  boost::optional<std::uint64_t> Delete(const NameType& name);
+  boost::optional<std::vector<byte>> Get(const NameType& name) const;
+  // Up to 'length' bytes of the value from 'offset', fewer if the value ends sooner.
+  boost::optional<std::vector<byte>> GetRange(const NameType& name, std::uint64_t offset,
+                                              std::uint64_t length) const;
+  boost::optional<std::uint64_t> Size(const NameType& name) const;
+  std::vector<NameType> Names() const;
+  // Calls 'visitor' with each name from 'first' onwards, if given, in ascending order until it
+  // returns false.  Names of equal length are ordered by name and then type.  It is called while
+  // holding the store's lock, and so must not call back into the store.
+  void VisitNames(const boost::optional<NameType>& first,
+                  const std::function<bool(const NameType&)>& visitor) const;
+
+  // The space a Put of a 'value_size' byte value under 'name' appends, or a Delete if zero.
+  static std::uint64_t SpaceRequired(const NameType& name, std::uint64_t value_size);
+  // Total size of the live values, excluding record headers, tombstones and superseded records.
+  std::uint64_t LiveBytes() const;
+  // Total size of the segment files, i.e. the disk space actually used, dead records included.
+  std::uint64_t DiskBytes() const;
+  // Arranges for 'on_reclaimed' to be passed the number of bytes freed each time compaction
+  // removes a segment, and returns DiskBytes() as of then.  It is called while holding the store's
+  // lock so that it's ordered with the returned value, and so must not call back into the store.
+  std::uint64_t WatchReclaimed(std::function<void(std::uint64_t)> on_reclaimed);
+  std::size_t SegmentCount() const;
+  // Flushes every record appended since the last successful call to stable storage.
+  bool Sync();
+  // Synchronously compacts every sealed segment which is at least half dead.
+  void Compact();
+  // Synchronously compacts segments holding dead records, the deadest first and whatever their
+  // proportion, until 'required_space' bytes have been freed or no more can be.  The active segment
+  // is sealed first if it holds any.  Returns the number of bytes freed.
+  std::uint64_t Reclaim(std::uint64_t required_space);
+
+ private:
+  struct Segment {
+    Segment(boost::filesystem::path path_in, std::uint32_t id_in);
+    ~Segment();
+    const boost::filesystem::path path;
+    const std::uint32_t id;
+    std::uint64_t size, dead_bytes;
+    // A retired segment's file is removed once the last reader releases it.
+    bool retired;
+    // Set for a sealed segment found to be corrupt on replay.  It's kept, but never compacted, so
+    // that the records past the corruption aren't lost for good.
+    bool quarantined;
+  };
+
+  struct Location {
+    std::shared_ptr<Segment> segment;
+    std::uint64_t offset;
+    std::uint32_t length;
+  };
+
+  static std::string Key(const NameType& name);
+  static NameType KeyName(const std::string& key);
+  // Creates the root if need be and replays its segments.
+  void Open();
+  // Only the newest segment can end in a record torn by a crash, which is truncated.
+  void Replay(const std::shared_ptr<Segment>& segment, bool newest);
+  void OpenNewSegment();
+  // Implements Sync(); requires 'mutex_'.
+  bool DoSync();
+  // Appends a record to the active segment and returns the offset of its value.
+  std::uint64_t Append(const std::string& key, bool tombstone, const std::vector<byte>& content);
+  std::shared_ptr<Segment> NextCompactionCandidate() const;
+  // Returns the number of bytes freed.  Leaves 'segment' in place, to be retried, if its copied
+  // records can't be synced.
+  std::uint64_t CompactSegment(const std::shared_ptr<Segment>& segment);
+  void CompactionLoop();
+
+  const boost::filesystem::path kRoot_;
+  const std::uint64_t kMaxSegmentSize_;
+  mutable std::mutex mutex_;
+  // Serialises compaction runs, which otherwise only take 'mutex_' briefly per record.
+  std::mutex compaction_mutex_;
+  // Ordered so that names can be listed a page at a time.
+  std::map<std::string, Location> index_;
+  std::map<std::uint32_t, std::shared_ptr<Segment>> segments_;
+  std::shared_ptr<Segment> active_segment_;
+  std::ofstream active_stream_;
+  std::uint64_t live_bytes_, disk_bytes_;
+  std::function<void(std::uint64_t)> on_reclaimed_;
+  std::uint32_t unsynced_segment_id_;
+  std::condition_variable compaction_condition_;
+  bool compaction_pending_, stop_compaction_;
+  std::thread compaction_thread_;
+};
+
+}  // namespace vault
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_VAULT_PACK_STORE_H_
@@ -22,9 +22,11 @@
 #include <string>
 #include <vector>
 
+#include "maidsafe/common/log.h"
 #include "maidsafe/common/types.h"
 #include "maidsafe/routing/types.h"
 
+#include "maidsafe/vault/chunk_scrubber.h"
 #include "maidsafe/vault/chunk_store.h"
 
 
@@ -36,6 +38,8 @@ template <typename FacadeType>
 class PmidNode {
  public:
   PmidNode(const boost::filesystem::path vault_root_dir, DiskUsage max_disk_usage);
+  // Logs the permanent store's metrics, so that a slow node can be diagnosed after the fact.
+  ~PmidNode();
 
   routing::HandleGetReturn HandleGet(routing::SourceAddress from,
                                      Data::NameAndTypeId name_and_type_id);
@@ -45,10 +49,14 @@ class PmidNode {
   void HandleChurn(routing::CloseGroupDifference);
 
  private:
+  static ChunkStore::Options PermanentStoreOptions();
+
 //  boost::filesystem::space_info space_info_;
   DiskUsage disk_total_;
   DiskUsage permanent_size_;
   ChunkStore chunk_store_;
+  // Declared after 'chunk_store_' so that it stops first.
+  ChunkScrubber scrubber_;
 };
 
 template <typename FacadeType>
@@ -58,7 +66,33 @@ PmidNode<FacadeType>::PmidNode(const boost::filesystem::path vault_root_dir,
 //      disk_total_(space_info_.available),
       disk_total_(max_disk_usage),
       permanent_size_(disk_total_ * 4 / 5),
-      chunk_store_(vault_root_dir / "pmid_node" / "permanent", max_disk_usage) {}
+      chunk_store_(vault_root_dir / "pmid_node" / "permanent", max_disk_usage,
+                   PermanentStoreOptions()),
+      scrubber_(chunk_store_, [this](const Data::NameAndTypeId& obfuscated_name,
+                                     const maidsafe_error& error) {
+        LOG(kError) << "Permanently held chunk " << obfuscated_name.name << " failed scrubbing: "
+                    << boost::diagnostic_information(error);
+        // Other errors, e.g. a failed read, say nothing about the chunk itself.  Once deleted, the
+        // next Get for it fails, which the DataManagers handle as for any lost copy by
+        // re-replicating the chunk from its other holders.
+        if (error.code() == make_error_code(CommonErrors::parsing_error))
+          chunk_store_.DeleteCorruptChunk(obfuscated_name);
+      }) {}
+
+template <typename FacadeType>
+PmidNode<FacadeType>::~PmidNode() {
+  LOG(kInfo) << "Permanent chunk store metrics (durations in microseconds):\n"
+             << chunk_store_.Metrics();
+}
+
+template <typename FacadeType>
+ChunkStore::Options PmidNode<FacadeType>::PermanentStoreOptions() {
+  ChunkStore::Options options;
+  // Full-sized chunks are mostly moved in bulk, e.g. during re-replication, so are kept out of the
+  // page cache in favour of the vault's databases.
+  options.direct_io_threshold = 256 * 1024;
+  return options;
+}
 
 template <typename FacadeType>
 routing::HandleGetReturn PmidNode<FacadeType>::HandleGet(routing::SourceAddress /* from */,
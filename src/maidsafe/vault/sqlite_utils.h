@@ -0,0 +1,61 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_VAULT_SQLITE_UTILS_H_
+#define MAIDSAFE_VAULT_SQLITE_UTILS_H_
+
+#include <exception>
+
+#include "maidsafe/common/log.h"
+#include "maidsafe/common/sqlite3_wrapper.h"
+
+namespace maidsafe {
+
+namespace vault {
+
+// Resets a statement which is prepared once and reused, when leaving the scope of one use.  This
+// stops it holding SQLite's read lock between uses, and readies it to be rebound by the next
+// caller even if this use failed part way.
+class ScopedStatementReset {
+ public:
+  explicit ScopedStatementReset(sqlite::Statement& statement) : statement_(statement) {}
+  ~ScopedStatementReset() {
+    try {
+      statement_.Reset();
+    } catch (const std::exception& e) {
+      LOG(kError) << "Failed to reset statement: " << boost::diagnostic_information(e);
+    }
+  }
+  ScopedStatementReset(const ScopedStatementReset&) = delete;
+  ScopedStatementReset& operator=(const ScopedStatementReset&) = delete;
+
+ private:
+  sqlite::Statement& statement_;
+};
+
+// Runs a reusable statement which returns no rows, such as a write or savepoint, and resets it.
+inline void StepAndReset(sqlite::Statement& statement) {
+  ScopedStatementReset reset(statement);
+  statement.Step();
+}
+
+}  // namespace vault
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_VAULT_SQLITE_UTILS_H_
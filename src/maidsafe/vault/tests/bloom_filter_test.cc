@@ -0,0 +1,81 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/vault/bloom_filter.h"
+
+#include <vector>
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace maidsafe {
+
+namespace vault {
+
+namespace test {
+
+TEST(CountingBloomFilterTest, BEH_AddRemove) {
+  CountingBloomFilter filter(1000);
+  const std::vector<byte> key(RandomBytes(64));
+  EXPECT_FALSE(filter.MayContain(key, 0));
+  filter.Add(key, 0);
+  EXPECT_TRUE(filter.MayContain(key, 0));
+  filter.Add(key, 0);
+  filter.Remove(key, 0);
+  EXPECT_TRUE(filter.MayContain(key, 0));
+  filter.Remove(key, 0);
+  EXPECT_FALSE(filter.MayContain(key, 0));
+  // Removing a key which was never added must not underflow a counter.
+  filter.Remove(key, 0);
+  filter.Add(key, 0);
+  EXPECT_TRUE(filter.MayContain(key, 0));
+}
+
+TEST(CountingBloomFilterTest, BEH_FalsePositiveRate) {
+  const std::uint32_t kElementCount(10000);
+  CountingBloomFilter filter(kElementCount);
+  std::vector<std::vector<byte>> keys;
+  for (std::uint32_t i(0); i != kElementCount; ++i) {
+    keys.push_back(RandomBytes(64));
+    filter.Add(keys.back(), i);
+  }
+  for (std::uint32_t i(0); i != kElementCount; ++i)
+    ASSERT_TRUE(filter.MayContain(keys[i], i));
+
+  std::uint32_t false_positives(0);
+  for (std::uint32_t i(0); i != kElementCount; ++i) {
+    if (filter.MayContain(RandomBytes(64), i))
+      ++false_positives;
+  }
+  // About 1% is expected.
+  EXPECT_LT(false_positives, kElementCount / 40);
+
+  // Keys differing only by salt are distinct.
+  std::uint32_t salted_positives(0);
+  for (std::uint32_t i(0); i != kElementCount; ++i) {
+    if (filter.MayContain(keys[i], i + kElementCount))
+      ++salted_positives;
+  }
+  EXPECT_LT(salted_positives, kElementCount / 40);
+}
+
+}  // namespace test
+
+}  // namespace vault
+
+}  // namespace maidsafe
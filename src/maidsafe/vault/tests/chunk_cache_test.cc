@@ -0,0 +1,101 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/vault/chunk_cache.h"
+
+#include <string>
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace maidsafe {
+
+namespace vault {
+
+namespace test {
+
+const std::uint32_t kValueSize(1024);
+
+std::string CacheKey(std::uint32_t index) { return "key" + std::to_string(index); }
+
+TEST(ChunkCacheTest, BEH_PutGetErase) {
+  ChunkCache cache(100 * kValueSize);
+  NonEmptyString value(RandomBytes(kValueSize));
+  EXPECT_FALSE(static_cast<bool>(cache.Get(CacheKey(0))));
+  cache.Put(CacheKey(0), value);
+  auto cached(cache.Get(CacheKey(0)));
+  ASSERT_TRUE(static_cast<bool>(cached));
+  EXPECT_TRUE(*cached == value);
+  EXPECT_EQ(1U, cache.Hits());
+  EXPECT_EQ(1U, cache.Misses());
+  EXPECT_EQ(kValueSize, cache.Size());
+
+  NonEmptyString replacement(RandomBytes(kValueSize / 2));
+  cache.Put(CacheKey(0), replacement);
+  EXPECT_TRUE(*cache.Get(CacheKey(0)) == replacement);
+  EXPECT_EQ(kValueSize / 2, cache.Size());
+
+  cache.Erase(CacheKey(0));
+  EXPECT_FALSE(static_cast<bool>(cache.Get(CacheKey(0))));
+  EXPECT_EQ(0U, cache.Size());
+
+  // Values which could never fit are ignored.
+  ChunkCache small_cache(kValueSize);
+  small_cache.Put(CacheKey(0), value);
+  EXPECT_EQ(0U, small_cache.Size());
+}
+
+TEST(ChunkCacheTest, BEH_Capacity) {
+  const std::uint32_t capacity_in_values(50);
+  ChunkCache cache(capacity_in_values * kValueSize);
+  NonEmptyString value(RandomBytes(kValueSize));
+  for (std::uint32_t i(0); i != 10 * capacity_in_values; ++i) {
+    cache.Get(CacheKey(i));
+    cache.Put(CacheKey(i), value);
+    EXPECT_GE(capacity_in_values * kValueSize, cache.Size());
+  }
+}
+
+TEST(ChunkCacheTest, BEH_ScanResistance) {
+  const std::uint32_t capacity_in_values(50), hot_count(20);
+  ChunkCache cache(capacity_in_values * kValueSize);
+  NonEmptyString value(RandomBytes(kValueSize));
+  auto read([&](std::uint32_t index) {
+    if (!cache.Get(CacheKey(index)))
+      cache.Put(CacheKey(index), value);
+  });
+
+  for (int round(0); round != 5; ++round) {
+    for (std::uint32_t i(0); i != hot_count; ++i)
+      read(i);
+  }
+  // A single pass over many more distinct chunks than the cache holds mustn't evict the hot set.
+  for (std::uint32_t i(hot_count); i != hot_count + 20 * capacity_in_values; ++i)
+    read(i);
+
+  const std::uint64_t hits_before(cache.Hits());
+  for (std::uint32_t i(0); i != hot_count; ++i)
+    read(i);
+  EXPECT_EQ(hits_before + hot_count, cache.Hits());
+}
+
+}  // namespace test
+
+}  // namespace vault
+
+}  // namespace maidsafe
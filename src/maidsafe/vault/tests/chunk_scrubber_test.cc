@@ -0,0 +1,219 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/vault/chunk_scrubber.h"
+
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "boost/filesystem/operations.hpp"
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+#include "maidsafe/vault/tests/chunk_store_test_utils.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+
+namespace vault {
+
+namespace test {
+
+const std::uint32_t kValueSize(1024);
+
+class ChunkScrubberTest : public testing::Test {
+ protected:
+  typedef std::vector<std::pair<ChunkStore::NameType, NonEmptyString>> NameValueContainer;
+
+  ChunkScrubberTest()
+      : test_path_(maidsafe::test::CreateTestPath("MaidSafe_Test_ChunkScrubber")),
+        chunk_store_(*test_path_ / "chunk_store", DiskUsage(1 << 20)),
+        mutex_(),
+        corrupt_names_() {}
+
+  ChunkScrubber::CorruptionFunctor RecordCorruption() {
+    return [this](const ChunkStore::NameType& obfuscated_name, const maidsafe_error&) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      corrupt_names_.insert(obfuscated_name);
+    };
+  }
+
+  // Overwrites the stored content of the chunk with the given obfuscated name.  The directories
+  // leading to a chunk's file are named by successive parts of its file name.
+  void Corrupt(const ChunkStore::NameType& obfuscated_name) {
+    const auto file_name(detail::GetFileName(obfuscated_name).string());
+    for (fs::recursive_directory_iterator itr(chunk_store_.DiskPath());
+         itr != fs::recursive_directory_iterator(); ++itr) {
+      if (!fs::is_regular_file(itr->path()))
+        continue;
+      std::string joined;
+      for (auto component(itr->path().rbegin());
+           component != itr->path().rend() && joined.size() < file_name.size(); ++component) {
+        joined = component->string() + joined;
+      }
+      if (joined == file_name) {
+        std::ofstream file(itr->path().string(), std::ios::binary | std::ios::trunc);
+        file << '\xff';
+        return;
+      }
+    }
+    FAIL() << "No file found for " << file_name;
+  }
+
+  template <typename Predicate>
+  bool WaitFor(Predicate predicate) {
+    const auto deadline(std::chrono::steady_clock::now() + std::chrono::seconds(10));
+    while (!predicate()) {
+      if (std::chrono::steady_clock::now() > deadline)
+        return false;
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return true;
+  }
+
+  maidsafe::test::TestPath test_path_;
+  ChunkStore chunk_store_;
+  std::mutex mutex_;
+  std::set<ChunkStore::NameType> corrupt_names_;
+};
+
+TEST_F(ChunkScrubberTest, BEH_FindsCorruption) {
+  NameValueContainer name_value_pairs;
+  AddRandomNameValuePairs(name_value_pairs, 20, kValueSize);
+  for (const auto& name_value : name_value_pairs)
+    chunk_store_.Put(name_value.first, name_value.second);
+  auto names(chunk_store_.Names());
+  ASSERT_EQ(20U, names.size());
+  Corrupt(names[3]);
+  Corrupt(names[11]);
+
+  ChunkScrubber::Options options;
+  options.bytes_per_second = 1 << 30;
+  ChunkScrubber scrubber(chunk_store_, RecordCorruption(), options);
+  ASSERT_TRUE(WaitFor([&] { return scrubber.CompletedPasses() != 0; }));
+  EXPECT_EQ(18U, scrubber.ChunksVerified());
+  EXPECT_EQ(0U, scrubber.ChunksUnverifiable());
+  EXPECT_EQ(2U, scrubber.CorruptChunks());
+  std::lock_guard<std::mutex> lock(mutex_);
+  EXPECT_EQ((std::set<ChunkStore::NameType>{names[3], names[11]}), corrupt_names_);
+}
+
+TEST_F(ChunkScrubberTest, BEH_DeleteCorruptChunk) {
+  NameValueContainer name_value_pairs;
+  AddRandomNameValuePairs(name_value_pairs, 20, kValueSize);
+  for (const auto& name_value : name_value_pairs)
+    chunk_store_.Put(name_value.first, name_value.second);
+  const auto disk_usage(chunk_store_.CurrentDiskUsage());
+  auto names(chunk_store_.Names());
+  ASSERT_EQ(20U, names.size());
+  Corrupt(names[3]);
+
+  // As the permanent store's owner does, so that Gets fail and the chunk is re-replicated.
+  ChunkScrubber::Options options;
+  options.bytes_per_second = 1 << 30;
+  ChunkScrubber scrubber(chunk_store_, [this](const ChunkStore::NameType& obfuscated_name,
+                                              const maidsafe_error& error) {
+    EXPECT_EQ(make_error_code(CommonErrors::parsing_error), error.code());
+    EXPECT_TRUE(chunk_store_.DeleteCorruptChunk(obfuscated_name));
+  }, options);
+  ASSERT_TRUE(WaitFor([&] { return scrubber.CompletedPasses() != 0; }));
+  EXPECT_EQ(1U, scrubber.CorruptChunks());
+  EXPECT_EQ(19U, chunk_store_.Names().size());
+  EXPECT_GT(disk_usage.data, chunk_store_.CurrentDiskUsage().data);
+  std::vector<size_t> missing;
+  for (size_t i(0); i != name_value_pairs.size(); ++i) {
+    try {
+      EXPECT_TRUE(chunk_store_.Get(name_value_pairs[i].first) == name_value_pairs[i].second);
+    } catch (const maidsafe_error& error) {
+      EXPECT_EQ(make_error_code(CommonErrors::no_such_element), error.code());
+      missing.push_back(i);
+    }
+  }
+  ASSERT_EQ(1U, missing.size());
+
+  // Intact chunks, including one stored afresh since it was found to be corrupt, are kept.
+  EXPECT_FALSE(chunk_store_.DeleteCorruptChunk(names[3]));
+  const auto& restored(name_value_pairs[missing.front()]);
+  chunk_store_.Put(restored.first, restored.second);
+  EXPECT_FALSE(chunk_store_.DeleteCorruptChunk(names[3]));
+  EXPECT_FALSE(chunk_store_.DeleteCorruptChunk(names[0]));
+  EXPECT_EQ(20U, chunk_store_.Names().size());
+  EXPECT_TRUE(chunk_store_.Get(restored.first) == restored.second);
+}
+
+TEST_F(ChunkScrubberTest, BEH_RateLimit) {
+  NameValueContainer name_value_pairs;
+  AddRandomNameValuePairs(name_value_pairs, 20, kValueSize);
+  for (const auto& name_value : name_value_pairs)
+    chunk_store_.Put(name_value.first, name_value.second);
+
+  // A budget of about five chunks a second.
+  ChunkScrubber::Options options;
+  options.bytes_per_second = 5 * kValueSize;
+  const auto start(std::chrono::steady_clock::now());
+  std::uint64_t verified(0);
+  {
+    ChunkScrubber scrubber(chunk_store_, RecordCorruption(), options);
+    ASSERT_TRUE(WaitFor([&] { return scrubber.ChunksVerified() >= 3; }));
+    verified = scrubber.ChunksVerified();
+  }
+  const std::chrono::duration<double> elapsed(std::chrono::steady_clock::now() - start);
+  EXPECT_LE(static_cast<double>(verified), 2.0 + 5.0 * elapsed.count());
+  EXPECT_LT(0.3, elapsed.count());
+}
+
+TEST_F(ChunkScrubberTest, BEH_YieldsToForeground) {
+  NameValueContainer name_value_pairs;
+  AddRandomNameValuePairs(name_value_pairs, 20, kValueSize);
+  for (const auto& name_value : name_value_pairs)
+    chunk_store_.Put(name_value.first, name_value.second);
+
+  ChunkScrubber::Options options;
+  options.bytes_per_second = 20 * kValueSize;
+  options.yield_delay = std::chrono::milliseconds(50);
+  ChunkScrubber scrubber(chunk_store_, RecordCorruption(), options);
+  // While the store is kept busy, scrubbing makes no progress once the scrubber has noticed.
+  auto keep_busy([&](std::chrono::milliseconds duration) {
+    const auto busy_until(std::chrono::steady_clock::now() + duration);
+    while (std::chrono::steady_clock::now() < busy_until) {
+      chunk_store_.Get(name_value_pairs.front().first);
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+  });
+  keep_busy(std::chrono::milliseconds(100));
+  const std::uint64_t verified_while_busy(scrubber.ChunksVerified());
+  keep_busy(std::chrono::milliseconds(300));
+  EXPECT_EQ(verified_while_busy, scrubber.ChunksVerified());
+  EXPECT_GT(20U, scrubber.ChunksVerified());
+  // Once it goes quiet, the scrubber catches up.
+  EXPECT_TRUE(WaitFor([&] { return scrubber.CompletedPasses() != 0; }));
+  EXPECT_EQ(20U, scrubber.ChunksVerified());
+  EXPECT_EQ(0U, scrubber.CorruptChunks());
+}
+
+}  // namespace test
+
+}  // namespace vault
+
+}  // namespace maidsafe
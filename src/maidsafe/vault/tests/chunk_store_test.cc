@@ -18,7 +18,14 @@
 
 #include "maidsafe/vault/chunk_store.h"
 
+#include <atomic>
+#include <fstream>
+#include <functional>
+#include <future>
 #include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
 
 #include "boost/filesystem/path.hpp"
 #include "boost/filesystem/operations.hpp"
@@ -42,9 +49,39 @@ namespace vault {
 namespace test {
 
 const std::uint64_t OneKB(1024);
-const std::uint64_t AesPadding(16);
-// Allow 16 bytes extra per chunk since we're AES encrypting them
-const std::uint64_t kDefaultMaxDiskUsage(4 * (OneKB + AesPadding));
+// Each chunk is stored with a 24 byte header followed by a flags byte.
+const std::uint64_t ChunkHeaderSize(25);
+// Allow 41 bytes extra per chunk: 16 since we're AES encrypting them, and the header
+const std::uint64_t ChunkOverhead(16 + ChunkHeaderSize);
+const std::uint64_t kDefaultMaxDiskUsage(4 * (OneKB + ChunkOverhead));
+// The pack file backend also writes a record header, the name and the type id for every Put, and
+// appends a record of that size for every Delete.
+const std::uint64_t PackRecordOverhead(10 + 64 + 4);
+
+ChunkStore::Options BackendOptions(ChunkStore::Backend backend) {
+  ChunkStore::Options options;
+  options.backend = backend;
+  return options;
+}
+
+// The disk usage of a chunk with 'stored_size' bytes of content.
+std::uint64_t ChunkSpace(ChunkStore::Backend backend, std::uint64_t stored_size) {
+  return stored_size + (backend == ChunkStore::Backend::kPackFile ? PackRecordOverhead : 0);
+}
+
+// The total size of the chunk files or pack segments under 'root'.
+std::uint64_t BytesOnDisk(const fs::path& root) {
+  std::uint64_t total(0);
+  for (fs::recursive_directory_iterator itr(root); itr != fs::recursive_directory_iterator();
+       ++itr) {
+    const std::string file_name(itr->path().filename().string());
+    if (fs::is_regular_file(itr->status()) && file_name != "manifest" &&
+        file_name != "usage_ledger") {
+      total += fs::file_size(itr->path());
+    }
+  }
+  return total;
+}
 
 class ChunkStoreTest : public testing::Test {
  public:
@@ -89,7 +126,7 @@ class ChunkStoreTest : public testing::Test {
 
     AddRandomNameValuePairs(name_value_pairs, num_entries, OneKB);
 
-    DiskUsage disk_usage(disk_entries * (OneKB + AesPadding));
+    DiskUsage disk_usage(disk_entries * (OneKB + ChunkOverhead));
     chunk_store_.reset(new ChunkStore(chunk_store_path_, disk_usage));
     for (auto name_value : name_value_pairs) {
       EXPECT_NO_THROW(chunk_store_->Put(name_value.first, name_value.second));
@@ -99,6 +136,38 @@ class ChunkStoreTest : public testing::Test {
     return name_value_pairs;
   }
 
+  // Rearranges the chunks in the closed store at 'root' into the original five levels of single
+  // character directories, strips their headers and drops the manifest and now inaccurate usage
+  // ledger, leaving a store as written by the previous version.  If 'keep_copies' is set, each
+  // chunk is also left in the current layout (without its header), as if a crash had interrupted
+  // the migration or a Put.
+  void ConvertToLegacyLayout(const fs::path& root, bool keep_copies) {
+    std::vector<fs::path> chunk_paths;
+    for (fs::recursive_directory_iterator itr(root); itr != fs::recursive_directory_iterator();
+         ++itr) {
+      if (fs::is_regular_file(itr->status()) && itr.level() > 0)
+        chunk_paths.push_back(itr->path());
+    }
+    for (const auto& chunk_path : chunk_paths) {
+      std::string file_name(chunk_path.parent_path().filename().string() +
+                            chunk_path.filename().string());
+      fs::path legacy_path(root);
+      for (size_t i(0); i != 5; ++i)
+        legacy_path /= file_name.substr(i, 1);
+      fs::create_directories(legacy_path);
+      auto content(ReadFile(chunk_path));
+      ASSERT_TRUE(static_cast<bool>(content));
+      content->erase(content->begin(), content->begin() + ChunkHeaderSize);
+      ASSERT_TRUE(WriteFile(legacy_path / file_name.substr(5), *content));
+      if (keep_copies)
+        ASSERT_TRUE(WriteFile(chunk_path, *content));
+      else
+        fs::remove(chunk_path);
+    }
+    fs::remove(root / "manifest");
+    fs::remove(root / "usage_ledger");
+  }
+
   void PrintResult(const pt::ptime& start_time, const pt::ptime& stop_time) {
     std::uint64_t duration = (stop_time - start_time).total_microseconds();
     if (duration == 0)
@@ -133,23 +202,26 @@ TEST_F(ChunkStoreTest, BEH_RemoveDiskStore) {
   maidsafe::test::TestPath test_path(maidsafe::test::CreateTestPath("MaidSafe_Test_ChunkStore"));
   fs::path chunk_store_path(*test_path / "new_permanent_store");
   const std::uintmax_t kSize(1), kDiskSize(116);
+  // The root, its manifest and the 256 precreated directories of the default layout.
+  const std::uintmax_t kEmptyStoreEntries(2 + 256);
   chunk_store_.reset(new ChunkStore(chunk_store_path, DiskUsage(kDiskSize)));
   NameType name(MakeIdentity(), DataTypeId(RandomUint32()));
   NonEmptyString small_value(RandomBytes(kSize));
   ASSERT_NO_THROW(chunk_store_->Put(name, small_value));
   ASSERT_NO_THROW(chunk_store_->Delete(name));
-  EXPECT_TRUE(6 == fs::remove_all(chunk_store_path, error_code));
+  EXPECT_EQ(kEmptyStoreEntries, fs::remove_all(chunk_store_path, error_code));
   ASSERT_FALSE(fs::exists(chunk_store_path, error_code));
   NameType name1(MakeIdentity(), DataTypeId(RandomUint32()));
   // The data gets AES encrypted and will end up at most 16 bytes larger when written to the store
-  NonEmptyString large_value(RandomBytes(kDiskSize - AesPadding));
+  NonEmptyString large_value(RandomBytes(kDiskSize - ChunkOverhead));
   EXPECT_THROW(chunk_store_->Put(name, small_value), std::exception);
   EXPECT_THROW(chunk_store_->Get(name), std::exception);
   EXPECT_THROW(chunk_store_->Delete(name), std::exception);
   chunk_store_.reset(new ChunkStore(chunk_store_path, DiskUsage(kDiskSize)));
   ASSERT_NO_THROW(chunk_store_->Put(name1, large_value));
   ASSERT_NO_THROW(chunk_store_->Delete(name1));
-  EXPECT_TRUE(6 != fs::remove_all(chunk_store_path, error_code));
+  // The failed operations on 'name' above mustn't have recreated any directories.
+  EXPECT_EQ(kEmptyStoreEntries, fs::remove_all(chunk_store_path, error_code));
   ASSERT_FALSE(fs::exists(chunk_store_path, error_code));
   EXPECT_THROW(chunk_store_->Put(name, small_value), std::exception);
   EXPECT_THROW(chunk_store_->Get(name), std::exception);
@@ -205,7 +277,7 @@ TEST_F(ChunkStoreTest, BEH_RepeatedlyStoreUsingSameName) {
   ASSERT_NO_THROW(recovered = chunk_store_->Get(name));
   EXPECT_TRUE(value != recovered);
   EXPECT_TRUE(last_value == recovered);
-  EXPECT_EQ(last_value.string().size() + AesPadding, chunk_store_->CurrentDiskUsage().data);
+  EXPECT_EQ(last_value.string().size() + ChunkOverhead, chunk_store_->CurrentDiskUsage().data);
 }
 
 TEST_F(ChunkStoreTest, FUNC_Restart) {
@@ -218,7 +290,956 @@ TEST_F(ChunkStoreTest, FUNC_Restart) {
   chunk_store_.reset(new ChunkStore(chunk_store_path_, disk_usage));
   pt::ptime stop_time(pt::microsec_clock::universal_time());
   PrintResult(start_time, stop_time);
-  EXPECT_EQ((num_entries * (OneKB + AesPadding)), chunk_store_->CurrentDiskUsage().data);
+  EXPECT_EQ((num_entries * (OneKB + ChunkOverhead)), chunk_store_->CurrentDiskUsage().data);
+}
+
+TEST_F(ChunkStoreTest, BEH_UsageLedger) {
+  const size_t num_entries(10);
+  const DiskUsage max_disk_usage(num_entries * (OneKB + ChunkOverhead));
+  NameValueContainer name_value_pairs(
+      PopulateChunkStore(num_entries, num_entries, chunk_store_path_));
+  const DiskUsage disk_usage(chunk_store_->CurrentDiskUsage());
+  const fs::path ledger_path(chunk_store_path_ / "usage_ledger");
+
+  // A clean shutdown records the usage, and the next instance consumes the ledger.
+  chunk_store_.reset();
+  EXPECT_TRUE(fs::exists(ledger_path));
+  chunk_store_.reset(new ChunkStore(chunk_store_path_, max_disk_usage));
+  EXPECT_FALSE(fs::exists(ledger_path));
+  EXPECT_EQ(disk_usage, chunk_store_->CurrentDiskUsage());
+  EXPECT_EQ(num_entries, chunk_store_->Names().size());
+
+  // A corrupt ledger is ignored and the usage is recovered by rescanning.
+  chunk_store_.reset();
+  EXPECT_TRUE(WriteFile(ledger_path, convert::ToByteVector("corrupt")));
+  chunk_store_.reset(new ChunkStore(chunk_store_path_, max_disk_usage));
+  EXPECT_EQ(disk_usage, chunk_store_->CurrentDiskUsage());
+
+  // A store which wasn't shut down cleanly leaves no ledger behind.
+  chunk_store_.reset(new ChunkStore(chunk_store_path_, max_disk_usage));
+  EXPECT_FALSE(fs::exists(ledger_path));
+  for (const auto& name_value : name_value_pairs)
+    EXPECT_NO_THROW(chunk_store_->Delete(name_value.first));
+  chunk_store_.reset(new ChunkStore(chunk_store_path_, max_disk_usage));
+  EXPECT_EQ(0U, chunk_store_->CurrentDiskUsage().data);
+}
+
+TEST_F(ChunkStoreTest, BEH_LayoutMigration) {
+  const size_t num_entries(4);
+  NameValueContainer name_value_pairs;
+  AddRandomNameValuePairs(name_value_pairs, num_entries, OneKB);
+  fs::path root(*test_path / "migrated");
+  chunk_store_.reset(new ChunkStore(root, max_disk_usage_));
+  for (const auto& name_value : name_value_pairs)
+    ASSERT_NO_THROW(chunk_store_->Put(name_value.first, name_value.second));
+  chunk_store_.reset();
+  ConvertToLegacyLayout(root, false);
+  const std::uint64_t kLegacyChunkSize(OneKB + ChunkOverhead - ChunkHeaderSize);
+  ASSERT_EQ(num_entries * kLegacyChunkSize, BytesOnDisk(root));
+
+  chunk_store_.reset(new ChunkStore(root, max_disk_usage_));
+  EXPECT_EQ(num_entries * kLegacyChunkSize, chunk_store_->CurrentDiskUsage().data);
+  // Chunks are accessible and modifiable whether or not they have been moved yet.
+  NonEmptyString new_value(RandomBytes(OneKB));
+  ASSERT_NO_THROW(chunk_store_->Put(name_value_pairs[0].first, new_value));
+  ASSERT_NO_THROW(chunk_store_->Delete(name_value_pairs[1].first));
+  EXPECT_TRUE(chunk_store_->Get(name_value_pairs[0].first) == new_value);
+  for (size_t i(2); i != num_entries; ++i)
+    EXPECT_TRUE(chunk_store_->Get(name_value_pairs[i].first) == name_value_pairs[i].second);
+
+  for (int i(0); i != 100 && chunk_store_->LayoutMigrationPending(); ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  ASSERT_FALSE(chunk_store_->LayoutMigrationPending());
+  for (fs::directory_iterator itr(root); itr != fs::directory_iterator(); ++itr)
+    EXPECT_NE(1U, itr->path().filename().string().size()) << itr->path();
+  EXPECT_EQ(num_entries - 1, chunk_store_->Names().size());
+  EXPECT_EQ((num_entries - 1) * kLegacyChunkSize, chunk_store_->CurrentDiskUsage().data);
+  EXPECT_TRUE(chunk_store_->Get(name_value_pairs[0].first) == new_value);
+  for (size_t i(2); i != num_entries; ++i)
+    EXPECT_TRUE(chunk_store_->Get(name_value_pairs[i].first) == name_value_pairs[i].second);
+  EXPECT_THROW(chunk_store_->Get(name_value_pairs[1].first), maidsafe_error);
+
+  // The completed migration is recorded, so reopening doesn't start another.
+  chunk_store_.reset(new ChunkStore(root, max_disk_usage_));
+  EXPECT_FALSE(chunk_store_->LayoutMigrationPending());
+}
+
+TEST_F(ChunkStoreTest, BEH_LegacyCopyAccounting) {
+  const size_t num_entries(4);
+  NameValueContainer name_value_pairs;
+  AddRandomNameValuePairs(name_value_pairs, num_entries, OneKB);
+  fs::path root(*test_path / "migrated");
+  chunk_store_.reset(new ChunkStore(root, max_disk_usage_));
+  for (const auto& name_value : name_value_pairs)
+    ASSERT_NO_THROW(chunk_store_->Put(name_value.first, name_value.second));
+  chunk_store_.reset();
+  ConvertToLegacyLayout(root, true);
+  const std::uint64_t kLegacyChunkSize(OneKB + ChunkOverhead - ChunkHeaderSize);
+
+  // Both copies of each chunk are counted until removed, by a Put, Delete or the migration, and
+  // the stale copy is never moved back into place.
+  chunk_store_.reset(new ChunkStore(root, DiskUsage(2 * num_entries * kLegacyChunkSize)));
+  EXPECT_EQ(2 * num_entries * kLegacyChunkSize, chunk_store_->CurrentDiskUsage().data);
+  NonEmptyString new_value(RandomBytes(OneKB));
+  ASSERT_NO_THROW(chunk_store_->Put(name_value_pairs[0].first, new_value));
+  ASSERT_NO_THROW(chunk_store_->Delete(name_value_pairs[1].first));
+  for (int i(0); i != 100 && chunk_store_->LayoutMigrationPending(); ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  ASSERT_FALSE(chunk_store_->LayoutMigrationPending());
+  EXPECT_EQ((num_entries - 1) * kLegacyChunkSize, chunk_store_->CurrentDiskUsage().data);
+  EXPECT_EQ(BytesOnDisk(root), chunk_store_->CurrentDiskUsage().data);
+  EXPECT_EQ(num_entries - 1, chunk_store_->Names().size());
+  EXPECT_THROW(chunk_store_->Get(name_value_pairs[1].first), maidsafe_error);
+  EXPECT_TRUE(chunk_store_->Get(name_value_pairs[0].first) == new_value);
+  for (size_t i(2); i != num_entries; ++i)
+    EXPECT_TRUE(chunk_store_->Get(name_value_pairs[i].first) == name_value_pairs[i].second);
+}
+
+TEST_F(ChunkStoreTest, BEH_PackFileBackend) {
+  const size_t num_entries(10);
+  const auto kPackFile(ChunkStore::Backend::kPackFile);
+  const DiskUsage max_disk_usage(num_entries * ChunkSpace(kPackFile, OneKB + ChunkOverhead));
+  fs::path pack_path(*test_path / "pack_store");
+  chunk_store_.reset(new ChunkStore(pack_path, max_disk_usage, BackendOptions(kPackFile)));
+  NameValueContainer name_value_pairs;
+  AddRandomNameValuePairs(name_value_pairs, num_entries, OneKB);
+  NonEmptyString recovered;
+  for (const auto& name_value : name_value_pairs) {
+    ASSERT_NO_THROW(chunk_store_->Put(name_value.first, name_value.second));
+    ASSERT_NO_THROW(recovered = chunk_store_->Get(name_value.first));
+    EXPECT_TRUE(recovered == name_value.second);
+  }
+  EXPECT_EQ(max_disk_usage, chunk_store_->CurrentDiskUsage());
+  EXPECT_EQ(max_disk_usage.data, BytesOnDisk(pack_path));
+  NameType name(MakeIdentity(), DataTypeId(RandomUint32()));
+  EXPECT_THROW(chunk_store_->Put(name, NonEmptyString(RandomBytes(OneKB))), std::exception);
+
+  // The deleted chunk's record stays on disk alongside the tombstone, until compacted to make
+  // room for the next Put.
+  ASSERT_NO_THROW(chunk_store_->Delete(name_value_pairs[0].first));
+  EXPECT_EQ(max_disk_usage.data + PackRecordOverhead, chunk_store_->CurrentDiskUsage().data);
+  EXPECT_THROW(chunk_store_->Get(name_value_pairs[0].first), std::exception);
+  EXPECT_THROW(chunk_store_->Delete(name_value_pairs[0].first), std::exception);
+  NonEmptyString small_value(RandomBytes(OneKB / 2));
+  ASSERT_NO_THROW(chunk_store_->Put(name_value_pairs[1].first, small_value));
+  const DiskUsage disk_usage(chunk_store_->CurrentDiskUsage());
+  EXPECT_GE(max_disk_usage, disk_usage);
+  EXPECT_EQ(disk_usage.data, BytesOnDisk(pack_path));
+
+  // The pack file can only be opened by one store at a time.
+  EXPECT_THROW(ChunkStore(pack_path, max_disk_usage, BackendOptions(kPackFile)), maidsafe_error);
+  chunk_store_.reset();
+  chunk_store_.reset(new ChunkStore(pack_path, max_disk_usage, BackendOptions(kPackFile)));
+  EXPECT_EQ(disk_usage, chunk_store_->CurrentDiskUsage());
+  EXPECT_EQ(num_entries - 1, chunk_store_->Names().size());
+  ASSERT_NO_THROW(recovered = chunk_store_->Get(name_value_pairs[1].first));
+  EXPECT_TRUE(recovered == small_value);
+}
+
+TEST_F(ChunkStoreTest, BEH_NameEnumeration) {
+  const size_t num_entries(20);
+  NameValueContainer name_value_pairs;
+  for (size_t i(0); i != num_entries; ++i) {
+    name_value_pairs.emplace_back(NameType(MakeIdentity(), DataTypeId(i % 2)),
+                                  NonEmptyString(RandomBytes(1)));
+  }
+  for (auto backend : {ChunkStore::Backend::kFilePerChunk, ChunkStore::Backend::kPackFile}) {
+    maidsafe::test::TestPath enumeration_path(
+        maidsafe::test::CreateTestPath("MaidSafe_Test_ChunkStore"));
+    chunk_store_.reset(
+        new ChunkStore(*enumeration_path / "store", max_disk_usage_, BackendOptions(backend)));
+    for (const auto& name_value : name_value_pairs)
+      ASSERT_NO_THROW(chunk_store_->Put(name_value.first, name_value.second));
+    auto all_names(chunk_store_->Names());
+    ASSERT_EQ(num_entries, all_names.size());
+    std::sort(std::begin(all_names), std::end(all_names));
+
+    std::atomic<size_t> odd_count(0);
+    ChunkStore::NameFilter odd_filter;
+    odd_filter.type_id = DataTypeId(1);
+    chunk_store_->ForEachName(odd_filter, [&](const NameType& name) {
+      EXPECT_EQ(1U, name.type_id.data);
+      ++odd_count;
+    });
+    EXPECT_EQ(num_entries / 2, odd_count);
+
+    // Paging resumes exactly where the previous page left off.
+    std::vector<NameType> paged_names;
+    boost::optional<NameType> resume_after;
+    do {
+      auto page(chunk_store_->GetNamesPage(ChunkStore::NameFilter(), 3, resume_after));
+      EXPECT_GE(3U, page.names.size());
+      paged_names.insert(std::end(paged_names), std::begin(page.names), std::end(page.names));
+      resume_after = page.resume_after;
+    } while (resume_after);
+    EXPECT_TRUE(all_names == paged_names);
+
+    ChunkStore::NameFilter range_filter;
+    range_filter.first = all_names[5].name;
+    range_filter.last = all_names[15].name;
+    auto page(chunk_store_->GetNamesPage(range_filter, num_entries));
+    EXPECT_FALSE(page.resume_after);
+    EXPECT_TRUE(std::vector<NameType>(std::begin(all_names) + 5, std::begin(all_names) + 15) ==
+                page.names);
+  }
+}
+
+TEST_F(ChunkStoreTest, BEH_ReadCache) {
+  const size_t num_entries(4);
+  NameValueContainer name_value_pairs;
+  AddRandomNameValuePairs(name_value_pairs, num_entries, OneKB);
+  ChunkStore::Options options;
+  options.cache_capacity = 100 * OneKB;
+  chunk_store_.reset(new ChunkStore(*test_path / "cached", max_disk_usage_, options));
+  for (const auto& name_value : name_value_pairs)
+    ASSERT_NO_THROW(chunk_store_->Put(name_value.first, name_value.second));
+  for (int round(0); round != 3; ++round) {
+    for (const auto& name_value : name_value_pairs)
+      EXPECT_TRUE(chunk_store_->Get(name_value.first) == name_value.second);
+  }
+  EXPECT_EQ(num_entries, chunk_store_->CacheMisses());
+  EXPECT_EQ(2 * num_entries, chunk_store_->CacheHits());
+
+  // Overwriting or deleting a chunk must invalidate its cached value.
+  NonEmptyString new_value(RandomBytes(OneKB));
+  ASSERT_NO_THROW(chunk_store_->Put(name_value_pairs[0].first, new_value));
+  EXPECT_TRUE(chunk_store_->Get(name_value_pairs[0].first) == new_value);
+  EXPECT_EQ(num_entries + 1, chunk_store_->CacheMisses());
+  ASSERT_NO_THROW(chunk_store_->Delete(name_value_pairs[1].first));
+  EXPECT_THROW(chunk_store_->Get(name_value_pairs[1].first), maidsafe_error);
+}
+
+TEST_F(ChunkStoreTest, BEH_ExistenceChecks) {
+  const size_t num_entries(4);
+  NameValueContainer name_value_pairs;
+  AddRandomNameValuePairs(name_value_pairs, num_entries, OneKB);
+  for (size_t i(0); i != num_entries - 1; ++i)
+    ASSERT_NO_THROW(chunk_store_->Put(name_value_pairs[i].first, name_value_pairs[i].second));
+
+  // Reopening rebuilds the filter from the chunks on disk; answers are correct throughout.
+  chunk_store_.reset();
+  chunk_store_.reset(new ChunkStore(chunk_store_path_, max_disk_usage_));
+  for (size_t i(0); i != num_entries - 1; ++i)
+    EXPECT_TRUE(chunk_store_->Has(name_value_pairs[i].first));
+  while (!chunk_store_->ExistenceFilterReady())
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  for (size_t i(0); i != num_entries - 1; ++i)
+    EXPECT_TRUE(chunk_store_->Has(name_value_pairs[i].first));
+  const NameType& missing(name_value_pairs.back().first);
+  EXPECT_FALSE(chunk_store_->Has(missing));
+  EXPECT_THROW(chunk_store_->Get(missing), maidsafe_error);
+
+  ASSERT_NO_THROW(chunk_store_->Put(missing, name_value_pairs.back().second));
+  EXPECT_TRUE(chunk_store_->Has(missing));
+  EXPECT_TRUE(chunk_store_->Get(missing) == name_value_pairs.back().second);
+  for (const auto& name_value : name_value_pairs) {
+    ASSERT_NO_THROW(chunk_store_->Delete(name_value.first));
+    EXPECT_FALSE(chunk_store_->Has(name_value.first));
+  }
+
+  chunk_store_.reset(new ChunkStore(*test_path / "pack", max_disk_usage_,
+                                    BackendOptions(ChunkStore::Backend::kPackFile)));
+  EXPECT_FALSE(chunk_store_->ExistenceFilterReady());
+  ASSERT_NO_THROW(chunk_store_->Put(missing, name_value_pairs.back().second));
+  EXPECT_TRUE(chunk_store_->Has(missing));
+  EXPECT_FALSE(chunk_store_->Has(name_value_pairs.front().first));
+}
+
+TEST_F(ChunkStoreTest, BEH_Compression) {
+  std::string text;
+  while (text.size() < 64 * OneKB) {
+    text += "Message body " + std::to_string(text.size()) + " of some compressible text.";
+    text.append(200, '=');
+  }
+  const NonEmptyString compressible(convert::ToByteVector(text));
+  const NonEmptyString incompressible(RandomBytes(OneKB));
+  const NameType compressible_name(MakeIdentity(), DataTypeId(0));
+  const NameType incompressible_name(MakeIdentity(), DataTypeId(0));
+  const DiskUsage max_disk_usage(1024 * OneKB);
+  ChunkStore::Options options;
+  options.compression = true;
+  for (auto backend : {ChunkStore::Backend::kFilePerChunk, ChunkStore::Backend::kPackFile}) {
+    const fs::path store_path(*test_path / std::to_string(static_cast<int>(backend)));
+    options.backend = backend;
+    chunk_store_.reset(new ChunkStore(store_path, max_disk_usage, options));
+    ASSERT_NO_THROW(chunk_store_->Put(compressible_name, compressible));
+    EXPECT_GT(compressible.string().size() / 2, chunk_store_->CurrentDiskUsage().data);
+    const std::uint64_t compressed_usage(chunk_store_->CurrentDiskUsage().data);
+    ASSERT_NO_THROW(chunk_store_->Put(incompressible_name, incompressible));
+    EXPECT_EQ(compressed_usage + ChunkSpace(backend, OneKB + ChunkOverhead),
+              chunk_store_->CurrentDiskUsage().data);
+    EXPECT_TRUE(chunk_store_->Get(compressible_name) == compressible);
+    EXPECT_TRUE(chunk_store_->Get(incompressible_name) == incompressible);
+
+    // Each chunk's encoding is recorded, so it remains readable with compression disabled.
+    chunk_store_.reset();
+    chunk_store_.reset(new ChunkStore(store_path, max_disk_usage, BackendOptions(backend)));
+    EXPECT_TRUE(chunk_store_->Get(compressible_name) == compressible);
+    EXPECT_TRUE(chunk_store_->Get(incompressible_name) == incompressible);
+    ASSERT_NO_THROW(chunk_store_->Delete(compressible_name));
+    EXPECT_EQ(BytesOnDisk(store_path), chunk_store_->CurrentDiskUsage().data);
+  }
+}
+
+TEST_F(ChunkStoreTest, BEH_RangeReads) {
+  const NonEmptyString large(RandomBytes(10 * OneKB + 100)), small(RandomBytes(OneKB / 2));
+  const NameType large_name(MakeIdentity(), DataTypeId(0)), small_name(MakeIdentity(),
+                                                                       DataTypeId(0));
+  const std::vector<byte>& large_bytes(large.string());
+  auto expected_range([&](std::uint64_t offset, std::uint64_t length) {
+    const std::uint64_t end(std::min<std::uint64_t>(offset + length, large_bytes.size()));
+    return std::vector<byte>(std::begin(large_bytes) + std::min<std::uint64_t>(offset, end),
+                             std::begin(large_bytes) + end);
+  });
+  for (auto backend : {ChunkStore::Backend::kFilePerChunk, ChunkStore::Backend::kPackFile}) {
+    const fs::path store_path(*test_path / std::to_string(static_cast<int>(backend)));
+    ChunkStore::Options options(BackendOptions(backend));
+    options.segment_size = OneKB;
+    chunk_store_.reset(new ChunkStore(store_path, DiskUsage(64 * OneKB), options));
+    ASSERT_NO_THROW(chunk_store_->Put(large_name, large));
+    ASSERT_NO_THROW(chunk_store_->Put(small_name, small));
+    EXPECT_TRUE(chunk_store_->Get(large_name) == large);
+
+    // Within one segment, across segment boundaries, running off the end and starting past it.
+    for (const auto& range : std::vector<std::pair<std::uint64_t, std::uint64_t>>{
+             {0, 1}, {OneKB - 1, 2}, {5000, 3000}, {10 * OneKB, OneKB}, {20 * OneKB, 1}}) {
+      EXPECT_TRUE(chunk_store_->GetRange(large_name, range.first, range.second) ==
+                  expected_range(range.first, range.second));
+    }
+    const std::vector<byte>& small_bytes(small.string());
+    EXPECT_TRUE(chunk_store_->GetRange(small_name, 10, 20) ==
+                std::vector<byte>(std::begin(small_bytes) + 10, std::begin(small_bytes) + 30));
+    EXPECT_THROW(chunk_store_->GetRange(NameType(MakeIdentity(), DataTypeId(0)), 0, 1),
+                 maidsafe_error);
+
+    ChunkStore::Reader reader(*chunk_store_, large_name);
+    std::vector<byte> streamed;
+    for (auto bytes(reader.Read(777)); !bytes.empty(); bytes = reader.Read(777)) {
+      EXPECT_GE(777U, bytes.size());
+      streamed.insert(std::end(streamed), std::begin(bytes), std::end(bytes));
+    }
+    EXPECT_TRUE(streamed == large_bytes);
+    EXPECT_EQ(large_bytes.size(), reader.Position());
+    for (const auto& obfuscated_name : chunk_store_->Names())
+      EXPECT_NO_THROW(chunk_store_->VerifyStoredChunk(obfuscated_name));
+
+    // Segmented chunks remain readable whatever the current segment size.
+    chunk_store_.reset();
+    chunk_store_.reset(new ChunkStore(store_path, DiskUsage(64 * OneKB), BackendOptions(backend)));
+    EXPECT_TRUE(chunk_store_->Get(large_name) == large);
+    EXPECT_TRUE(chunk_store_->GetRange(large_name, 3000, 100) == expected_range(3000, 100));
+  }
+}
+
+TEST_F(ChunkStoreTest, BEH_ChunkHeaders) {
+  const NonEmptyString value(RandomBytes(OneKB)), large(RandomBytes(10 * OneKB));
+  const NameType name(MakeIdentity(), DataTypeId(0)), large_name(MakeIdentity(), DataTypeId(0));
+  ChunkStore::Options options;
+  options.segment_size = OneKB;
+  chunk_store_.reset(new ChunkStore(*test_path / "headers", DiskUsage(64 * OneKB), options));
+  ASSERT_NO_THROW(chunk_store_->Put(name, value));
+  ASSERT_NO_THROW(chunk_store_->Put(large_name, large));
+  std::vector<fs::path> chunk_paths;
+  for (fs::recursive_directory_iterator itr(chunk_store_->DiskPath());
+       itr != fs::recursive_directory_iterator(); ++itr) {
+    if (fs::is_regular_file(itr->status()) && itr.level() > 0)
+      chunk_paths.push_back(itr->path());
+  }
+  ASSERT_EQ(2U, chunk_paths.size());
+  for (const auto& obfuscated_name : chunk_store_->Names())
+    EXPECT_NO_THROW(chunk_store_->VerifyStoredChunk(obfuscated_name));
+
+  // A single flipped bit anywhere in a chunk is caught by its checksum, without decrypting it.
+  for (const auto& chunk_path : chunk_paths) {
+    auto content(ReadFile(chunk_path));
+    ASSERT_TRUE(static_cast<bool>(content));
+    (*content)[content->size() / 2] ^= 0x10;
+    ASSERT_TRUE(WriteFile(chunk_path, *content));
+  }
+  for (const auto& obfuscated_name : chunk_store_->Names()) {
+    try {
+      chunk_store_->VerifyStoredChunk(obfuscated_name);
+      ADD_FAILURE() << "Corruption not detected.";
+    } catch (const maidsafe_error& error) {
+      EXPECT_EQ(make_error_code(CommonErrors::parsing_error), error.code());
+    }
+  }
+  EXPECT_THROW(chunk_store_->Get(name), maidsafe_error);
+  EXPECT_THROW(chunk_store_->Get(large_name), maidsafe_error);
+}
+
+TEST_F(ChunkStoreTest, BEH_DirectIo) {
+  const std::uint64_t kThreshold(4 * OneKB);
+  // Around the threshold and the 4KiB alignment, and large enough to need several transfers.
+  const std::vector<std::uint64_t> kSizes{100, kThreshold - ChunkOverhead, kThreshold,
+                                          kThreshold + 1, 3 * 64 * OneKB + 5, 1536 * OneKB};
+  for (auto durability : {ChunkStore::Durability::kBuffered, ChunkStore::Durability::kAtomic}) {
+    ChunkStore::Options options;
+    options.direct_io_threshold = kThreshold;
+    options.durability = durability;
+    chunk_store_.reset(new ChunkStore(*test_path / std::to_string(static_cast<int>(durability)),
+                                      DiskUsage(8 * OneKB * OneKB), options));
+    NameValueContainer name_value_pairs;
+    for (auto size : kSizes) {
+      name_value_pairs.emplace_back(NameType(MakeIdentity(), DataTypeId(0)),
+                                    NonEmptyString(RandomBytes(static_cast<std::uint32_t>(size))));
+      ASSERT_NO_THROW(chunk_store_->Put(name_value_pairs.back().first,
+                                        name_value_pairs.back().second));
+    }
+    for (const auto& name_value : name_value_pairs)
+      EXPECT_TRUE(chunk_store_->Get(name_value.first) == name_value.second);
+
+    // Overwriting with smaller values mustn't leave any of the old content or padding behind.
+    for (auto& name_value : name_value_pairs) {
+      name_value.second = NonEmptyString(RandomBytes(
+          static_cast<std::uint32_t>(std::max<std::size_t>(name_value.second.string().size() / 3,
+                                                           1))));
+      ASSERT_NO_THROW(chunk_store_->Put(name_value.first, name_value.second));
+    }
+    for (const auto& name_value : name_value_pairs)
+      EXPECT_TRUE(chunk_store_->Get(name_value.first) == name_value.second);
+    std::uint64_t chunk_file_bytes(0);
+    for (fs::recursive_directory_iterator itr(chunk_store_->DiskPath());
+         itr != fs::recursive_directory_iterator(); ++itr) {
+      if (fs::is_regular_file(itr->path()) && itr->path().parent_path() != chunk_store_->DiskPath())
+        chunk_file_bytes += fs::file_size(itr->path());
+    }
+    EXPECT_EQ(chunk_store_->CurrentDiskUsage().data, chunk_file_bytes);
+  }
+}
+
+TEST_F(ChunkStoreTest, BEH_Durability) {
+  const std::uint32_t kThreadCount(4), kChunksPerThread(10);
+  const auto kAtomic(ChunkStore::Durability::kAtomic);
+  const auto kGroupCommit(ChunkStore::Durability::kGroupCommit);
+  for (auto backend : {ChunkStore::Backend::kFilePerChunk, ChunkStore::Backend::kPackFile}) {
+    for (auto durability : {kAtomic, kGroupCommit}) {
+      const fs::path store_path(*test_path / ("store" + std::to_string(static_cast<int>(backend)) +
+                                             std::to_string(static_cast<int>(durability))));
+      ChunkStore::Options options(BackendOptions(backend));
+      options.durability = durability;
+      // The pack file keeps an overwritten chunk's old record until compaction, so needs room for
+      // one more.
+      const std::uint64_t chunk_space(ChunkSpace(backend, OneKB + ChunkOverhead));
+      const std::uint32_t chunk_count(kThreadCount * kChunksPerThread +
+                                      (backend == ChunkStore::Backend::kPackFile ? 1 : 0));
+      chunk_store_.reset(new ChunkStore(store_path, DiskUsage(chunk_count * chunk_space),
+                                        options));
+      std::vector<NameValueContainer> name_value_pairs(kThreadCount);
+      for (auto& thread_pairs : name_value_pairs)
+        AddRandomNameValuePairs(thread_pairs, kChunksPerThread, OneKB);
+
+      // Concurrent Puts share group commits.
+      std::atomic<std::uint32_t> failures(0);
+      std::vector<std::thread> threads;
+      for (std::uint32_t i(0); i != kThreadCount; ++i) {
+        threads.emplace_back([&, i] {
+          for (const auto& name_value : name_value_pairs[i]) {
+            try {
+              chunk_store_->Put(name_value.first, name_value.second);
+            } catch (const std::exception&) {
+              ++failures;
+            }
+          }
+        });
+      }
+      for (auto& thread : threads)
+        thread.join();
+      EXPECT_EQ(0U, failures.load());
+      for (const auto& thread_pairs : name_value_pairs) {
+        for (const auto& name_value : thread_pairs)
+          EXPECT_TRUE(chunk_store_->Get(name_value.first) == name_value.second);
+      }
+
+      // Overwriting, overfilling and deleting leave no temporary files behind.
+      NonEmptyString new_value(RandomBytes(OneKB));
+      ASSERT_NO_THROW(chunk_store_->Put(name_value_pairs[0][0].first, new_value));
+      EXPECT_TRUE(chunk_store_->Get(name_value_pairs[0][0].first) == new_value);
+      EXPECT_THROW(chunk_store_->Put(NameType(MakeIdentity(), DataTypeId(0)),
+                                     NonEmptyString(RandomBytes(2 * OneKB))),
+                   maidsafe_error);
+      ASSERT_NO_THROW(chunk_store_->Delete(name_value_pairs[0][1].first));
+      auto batch_results(chunk_store_->DeleteMany({name_value_pairs[1][0].first}));
+      EXPECT_EQ(make_error_code(CommonErrors::success), batch_results[0].code());
+      for (fs::recursive_directory_iterator itr(store_path);
+           itr != fs::recursive_directory_iterator(); ++itr) {
+        EXPECT_NE(".staged", itr->path().extension()) << itr->path();
+      }
+      EXPECT_EQ(kThreadCount * kChunksPerThread - 2, chunk_store_->Names().size());
+    }
+  }
+
+  // Temporary files left by a crash are discarded when the store is next opened.
+  const fs::path crash_path(*test_path / "crash");
+  chunk_store_.reset(new ChunkStore(crash_path, max_disk_usage_));
+  ASSERT_NO_THROW(chunk_store_->Put(NameType(MakeIdentity(), DataTypeId(0)),
+                                    NonEmptyString(RandomBytes(OneKB))));
+  chunk_store_.reset();
+  const fs::path staged_path(crash_path / "00" / "0000_0.1.staged");
+  ASSERT_TRUE(WriteFile(staged_path, RandomBytes(OneKB)));
+  fs::remove(crash_path / "usage_ledger");
+  chunk_store_.reset(new ChunkStore(crash_path, max_disk_usage_));
+  EXPECT_EQ(OneKB + ChunkOverhead, chunk_store_->CurrentDiskUsage().data);
+  EXPECT_FALSE(fs::exists(staged_path));
+  EXPECT_EQ(1U, chunk_store_->Names().size());
+}
+
+TEST_F(ChunkStoreTest, BEH_AsyncOperations) {
+  const size_t num_entries(4);
+  NameValueContainer name_value_pairs;
+  AddRandomNameValuePairs(name_value_pairs, num_entries, OneKB);
+  std::vector<std::future<maidsafe_error>> put_results;
+  for (const auto& name_value : name_value_pairs) {
+    auto promise(std::make_shared<std::promise<maidsafe_error>>());
+    put_results.push_back(promise->get_future());
+    chunk_store_->AsyncPut(name_value.first, name_value.second,
+                           [promise](maidsafe_error error) { promise->set_value(error); });
+  }
+  for (auto& result : put_results)
+    EXPECT_EQ(make_error_code(CommonErrors::success), result.get().code());
+
+  // The store is now full, so a further Put must report the same error as the synchronous call.
+  std::promise<maidsafe_error> overfill_result;
+  chunk_store_->AsyncPut(NameType(MakeIdentity(), DataTypeId(RandomUint32())),
+                         NonEmptyString(RandomBytes(OneKB)),
+                         [&](maidsafe_error error) { overfill_result.set_value(error); });
+  EXPECT_EQ(make_error_code(CommonErrors::cannot_exceed_limit),
+            overfill_result.get_future().get().code());
+
+  for (const auto& name_value : name_value_pairs) {
+    std::promise<ChunkStore::GetResult> get_result;
+    chunk_store_->AsyncGet(name_value.first,
+                           [&](ChunkStore::GetResult result) { get_result.set_value(result); });
+    auto result(get_result.get_future().get());
+    ASSERT_TRUE(result.valid());
+    EXPECT_TRUE(*result == name_value.second);
+
+    std::promise<maidsafe_error> delete_result;
+    chunk_store_->AsyncDelete(name_value.first,
+                              [&](maidsafe_error error) { delete_result.set_value(error); });
+    EXPECT_EQ(make_error_code(CommonErrors::success), delete_result.get_future().get().code());
+  }
+
+  std::promise<ChunkStore::GetResult> missing_result;
+  chunk_store_->AsyncGet(name_value_pairs[0].first,
+                         [&](ChunkStore::GetResult result) { missing_result.set_value(result); });
+  auto result(missing_result.get_future().get());
+  ASSERT_FALSE(result.valid());
+  EXPECT_EQ(make_error_code(CommonErrors::no_such_element), result.error().code());
+  EXPECT_EQ(0U, chunk_store_->CurrentDiskUsage().data);
+
+  // Operations still queued on destruction complete before the usage ledger is written.
+  std::atomic<std::uint32_t> completed(0);
+  for (const auto& name_value : name_value_pairs) {
+    chunk_store_->AsyncPut(name_value.first, name_value.second,
+                           [&](maidsafe_error error) {
+                             EXPECT_EQ(make_error_code(CommonErrors::success), error.code());
+                             ++completed;
+                           });
+  }
+  chunk_store_.reset();
+  EXPECT_EQ(num_entries, completed.load());
+  chunk_store_.reset(new ChunkStore(chunk_store_path_, max_disk_usage_));
+  EXPECT_EQ(num_entries * (OneKB + ChunkOverhead), chunk_store_->CurrentDiskUsage().data);
+}
+
+TEST_F(ChunkStoreTest, BEH_BatchOperations) {
+  const size_t num_entries(4);
+  NameValueContainer name_value_pairs;
+  AddRandomNameValuePairs(name_value_pairs, num_entries, OneKB);
+  // One more than fits, so exactly one item must fail without affecting the others.
+  AddRandomNameValuePairs(name_value_pairs, 1, OneKB);
+  for (auto backend : {ChunkStore::Backend::kFilePerChunk, ChunkStore::Backend::kPackFile}) {
+    maidsafe::test::TestPath batch_path(
+        maidsafe::test::CreateTestPath("MaidSafe_Test_ChunkStore"));
+    const DiskUsage max_disk_usage(num_entries * ChunkSpace(backend, OneKB + ChunkOverhead));
+    chunk_store_.reset(
+        new ChunkStore(*batch_path / "store", max_disk_usage, BackendOptions(backend)));
+    auto put_results(chunk_store_->PutMany(name_value_pairs, true));
+    ASSERT_EQ(name_value_pairs.size(), put_results.size());
+    size_t failures(0);
+    std::vector<ChunkStore::NameType> names;
+    for (size_t i(0); i != put_results.size(); ++i) {
+      if (put_results[i].code() == make_error_code(CommonErrors::success)) {
+        names.push_back(name_value_pairs[i].first);
+      } else {
+        EXPECT_EQ(make_error_code(CommonErrors::cannot_exceed_limit), put_results[i].code());
+        ++failures;
+      }
+    }
+    EXPECT_EQ(1U, failures);
+    EXPECT_EQ(max_disk_usage, chunk_store_->CurrentDiskUsage());
+
+    names.push_back(NameType(MakeIdentity(), DataTypeId(RandomUint32())));
+    auto get_results(chunk_store_->GetMany(names));
+    ASSERT_EQ(names.size(), get_results.size());
+    for (size_t i(0); i != num_entries; ++i) {
+      ASSERT_TRUE(get_results[i].valid());
+      EXPECT_TRUE(*get_results[i] == chunk_store_->Get(names[i]));
+    }
+    ASSERT_FALSE(get_results.back().valid());
+    EXPECT_EQ(make_error_code(CommonErrors::no_such_element), get_results.back().error().code());
+
+    names.pop_back();
+    for (const auto& result : chunk_store_->DeleteMany(names, true))
+      EXPECT_EQ(make_error_code(CommonErrors::success), result.code());
+    EXPECT_EQ(BytesOnDisk(*batch_path / "store"), chunk_store_->CurrentDiskUsage().data);
+    EXPECT_TRUE(chunk_store_->Names().empty());
+  }
+}
+
+TEST_F(ChunkStoreTest, BEH_IdempotentImmutablePut) {
+  for (auto backend : {ChunkStore::Backend::kFilePerChunk, ChunkStore::Backend::kPackFile}) {
+    maidsafe::test::TestPath store_path(
+        maidsafe::test::CreateTestPath("MaidSafe_Test_ChunkStore"));
+    chunk_store_.reset(
+        new ChunkStore(*store_path / "store", max_disk_usage_, BackendOptions(backend)));
+    const NameType immutable_name(MakeIdentity(), detail::TypeId<ImmutableData>::value);
+    const NonEmptyString value(RandomBytes(OneKB));
+    ASSERT_NO_THROW(chunk_store_->Put(immutable_name, value));
+    const auto usage(chunk_store_->CurrentDiskUsage());
+    EXPECT_EQ(0U, chunk_store_->AvoidedWrites());
+
+    // Storing it again, singly or in a batch, leaves the original untouched.
+    ASSERT_NO_THROW(chunk_store_->Put(immutable_name, value));
+    EXPECT_EQ(1U, chunk_store_->AvoidedWrites());
+    for (const auto& result : chunk_store_->PutMany({{immutable_name, value}}))
+      EXPECT_EQ(make_error_code(CommonErrors::success), result.code());
+    EXPECT_EQ(2U, chunk_store_->AvoidedWrites());
+    EXPECT_EQ(usage.data, chunk_store_->CurrentDiskUsage().data);
+    EXPECT_TRUE(chunk_store_->Get(immutable_name) == value);
+
+    // Other types may change under the same name, so are always rewritten.
+    const NameType mutable_name(immutable_name.name, detail::TypeId<MutableData>::value);
+    const NonEmptyString new_value(RandomBytes(OneKB));
+    ASSERT_NO_THROW(chunk_store_->Put(mutable_name, value));
+    ASSERT_NO_THROW(chunk_store_->Put(mutable_name, new_value));
+    EXPECT_TRUE(chunk_store_->Get(mutable_name) == new_value);
+    EXPECT_EQ(2U, chunk_store_->AvoidedWrites());
+
+    // A corrupt stored copy is rewritten.
+    if (backend == ChunkStore::Backend::kFilePerChunk) {
+      const std::string suffix("_" + std::to_string(immutable_name.type_id.data));
+      for (fs::recursive_directory_iterator itr(*store_path / "store");
+           itr != fs::recursive_directory_iterator(); ++itr) {
+        const std::string file_name(itr->path().filename().string());
+        if (fs::is_regular_file(itr->status()) && file_name.size() > suffix.size() &&
+            file_name.compare(file_name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+          std::fstream file(itr->path().string(), std::ios::binary | std::ios::in | std::ios::out);
+          file.seekg(OneKB / 2);
+          const char original(static_cast<char>(file.get()));
+          file.seekp(OneKB / 2);
+          file.put(static_cast<char>(~original));
+        }
+      }
+      ASSERT_NO_THROW(chunk_store_->Put(immutable_name, value));
+      EXPECT_EQ(2U, chunk_store_->AvoidedWrites());
+      EXPECT_TRUE(chunk_store_->Get(immutable_name) == value);
+      ASSERT_NO_THROW(chunk_store_->Put(immutable_name, value));
+      EXPECT_EQ(3U, chunk_store_->AvoidedWrites());
+    }
+
+    // Once deleted, it is stored afresh.
+    const auto avoided_writes(chunk_store_->AvoidedWrites());
+    ASSERT_NO_THROW(chunk_store_->Delete(immutable_name));
+    ASSERT_NO_THROW(chunk_store_->Put(immutable_name, value));
+    EXPECT_EQ(avoided_writes, chunk_store_->AvoidedWrites());
+    EXPECT_TRUE(chunk_store_->Get(immutable_name) == value);
+  }
+}
+
+TEST_F(ChunkStoreTest, BEH_Metrics) {
+  using Operation = ChunkStoreMetrics::Operation;
+  using Phase = ChunkStoreMetrics::Phase;
+  auto operation([](const ChunkStoreMetrics::Snapshot& snapshot, Operation operation) {
+    return snapshot.operations[static_cast<std::size_t>(operation)];
+  });
+  auto phase([](const ChunkStoreMetrics::OperationSnapshot& operation, Phase phase) {
+    return operation.phases[static_cast<std::size_t>(phase)];
+  });
+  const size_t num_entries(3);
+  NameValueContainer name_value_pairs;
+  AddRandomNameValuePairs(name_value_pairs, num_entries, OneKB);
+  for (const auto& name_value : name_value_pairs)
+    ASSERT_NO_THROW(chunk_store_->Put(name_value.first, name_value.second));
+  EXPECT_TRUE(chunk_store_->Get(name_value_pairs[0].first) == name_value_pairs[0].second);
+  EXPECT_THROW(chunk_store_->Get(NameType(MakeIdentity(), DataTypeId(RandomUint32()))),
+               maidsafe_error);
+  std::vector<NameType> names;
+  for (const auto& name_value : name_value_pairs)
+    names.push_back(name_value.first);
+  chunk_store_->GetMany(names);
+  ASSERT_NO_THROW(chunk_store_->Delete(name_value_pairs[0].first));
+
+  auto snapshot(chunk_store_->Metrics());
+  auto puts(operation(snapshot, Operation::kPut));
+  EXPECT_EQ(num_entries, puts.calls);
+  EXPECT_EQ(num_entries, puts.chunks);
+  EXPECT_EQ(num_entries * OneKB, puts.bytes);
+  EXPECT_EQ(num_entries, puts.total.count);
+  for (auto timed_phase : {Phase::kLockWait, Phase::kCrypto, Phase::kPathResolution,
+                           Phase::kDiskIo}) {
+    EXPECT_EQ(num_entries, phase(puts, timed_phase).count);
+    EXPECT_LE(phase(puts, timed_phase).p50, puts.total.max);
+  }
+  EXPECT_LE(puts.total.p50, puts.total.p99);
+  EXPECT_LE(puts.total.p99, puts.total.max);
+
+  // Failed calls are timed, but don't count any bytes.
+  auto gets(operation(snapshot, Operation::kGet));
+  EXPECT_EQ(2U, gets.calls);
+  EXPECT_EQ(OneKB, gets.bytes);
+  auto get_many(operation(snapshot, Operation::kGetMany));
+  EXPECT_EQ(1U, get_many.calls);
+  EXPECT_EQ(num_entries, get_many.chunks);
+  EXPECT_EQ(num_entries * OneKB, get_many.bytes);
+  EXPECT_EQ(1U, operation(snapshot, Operation::kDelete).calls);
+  EXPECT_EQ(0U, operation(snapshot, Operation::kPutMany).calls);
+
+  std::ostringstream stream;
+  stream << snapshot;
+  EXPECT_NE(std::string::npos, stream.str().find("GetMany: 1 calls"));
+  EXPECT_EQ(std::string::npos, stream.str().find("PutMany"));
+}
+
+TEST_F(ChunkStoreTest, FUNC_BatchThroughput) {
+  const std::uint32_t num_entries(2000);
+  NameValueContainer name_value_pairs;
+  AddRandomNameValuePairs(name_value_pairs, num_entries, OneKB);
+  std::vector<NameType> names;
+  for (const auto& name_value : name_value_pairs)
+    names.push_back(name_value.first);
+  const DiskUsage max_disk_usage(num_entries * (OneKB + ChunkOverhead));
+  for (bool batched : {false, true}) {
+    maidsafe::test::TestPath batch_path(
+        maidsafe::test::CreateTestPath("MaidSafe_Test_ChunkStore"));
+    chunk_store_.reset(new ChunkStore(*batch_path / "store", max_disk_usage));
+    std::cout << (batched ? "Batched:" : "Individual:") << std::endl;
+    pt::ptime start_time(pt::microsec_clock::universal_time());
+    if (batched) {
+      for (const auto& result : chunk_store_->PutMany(name_value_pairs))
+        ASSERT_EQ(make_error_code(CommonErrors::success), result.code());
+    } else {
+      for (const auto& name_value : name_value_pairs)
+        ASSERT_NO_THROW(chunk_store_->Put(name_value.first, name_value.second));
+    }
+    std::cout << "  Put: ";
+    PrintResult(start_time, pt::microsec_clock::universal_time());
+    start_time = pt::microsec_clock::universal_time();
+    if (batched) {
+      for (const auto& result : chunk_store_->GetMany(names))
+        ASSERT_TRUE(result.valid());
+    } else {
+      for (const auto& name : names)
+        ASSERT_NO_THROW(chunk_store_->Get(name));
+    }
+    std::cout << "  Get: ";
+    PrintResult(start_time, pt::microsec_clock::universal_time());
+    start_time = pt::microsec_clock::universal_time();
+    if (batched) {
+      for (const auto& result : chunk_store_->DeleteMany(names))
+        ASSERT_EQ(make_error_code(CommonErrors::success), result.code());
+    } else {
+      for (const auto& name : names)
+        ASSERT_NO_THROW(chunk_store_->Delete(name));
+    }
+    std::cout << "  Delete: ";
+    PrintResult(start_time, pt::microsec_clock::universal_time());
+  }
+}
+
+TEST_F(ChunkStoreTest, FUNC_BackendComparison) {
+  const std::uint32_t num_entries(2000);
+  NameValueContainer name_value_pairs;
+  AddRandomNameValuePairs(name_value_pairs, num_entries, OneKB);
+  for (auto backend : {ChunkStore::Backend::kFilePerChunk, ChunkStore::Backend::kPackFile}) {
+    maidsafe::test::TestPath test_path(
+        maidsafe::test::CreateTestPath("MaidSafe_Test_ChunkStore"));
+    const DiskUsage max_disk_usage(num_entries * ChunkSpace(backend, OneKB + ChunkOverhead));
+    chunk_store_.reset(
+        new ChunkStore(*test_path / "store", max_disk_usage, BackendOptions(backend)));
+    std::cout << (backend == ChunkStore::Backend::kPackFile ? "Pack file" : "File per chunk")
+              << " backend:" << std::endl;
+    pt::ptime start_time(pt::microsec_clock::universal_time());
+    for (const auto& name_value : name_value_pairs)
+      ASSERT_NO_THROW(chunk_store_->Put(name_value.first, name_value.second));
+    std::cout << "  Put: ";
+    PrintResult(start_time, pt::microsec_clock::universal_time());
+    start_time = pt::microsec_clock::universal_time();
+    for (const auto& name_value : name_value_pairs)
+      ASSERT_TRUE(chunk_store_->Get(name_value.first) == name_value.second);
+    std::cout << "  Get: ";
+    PrintResult(start_time, pt::microsec_clock::universal_time());
+    start_time = pt::microsec_clock::universal_time();
+    for (const auto& name_value : name_value_pairs)
+      ASSERT_NO_THROW(chunk_store_->Delete(name_value.first));
+    std::cout << "  Delete: ";
+    PrintResult(start_time, pt::microsec_clock::universal_time());
+    chunk_store_.reset();
+  }
+}
+
+TEST_F(ChunkStoreTest, BEH_ConcurrentReservation) {
+  // Room for exactly 'kCapacity' chunks, contended for by more Puts than fit.
+  const std::uint32_t kThreadCount(8), kChunksPerThread(4), kCapacity(10);
+  chunk_store_.reset(new ChunkStore(chunk_store_path_,
+                                    DiskUsage(kCapacity * (OneKB + ChunkOverhead))));
+  std::vector<NameValueContainer> name_value_pairs(kThreadCount);
+  for (auto& thread_pairs : name_value_pairs)
+    AddRandomNameValuePairs(thread_pairs, kChunksPerThread, OneKB);
+
+  std::atomic<std::uint32_t> stored(0);
+  std::vector<std::thread> threads;
+  for (std::uint32_t i(0); i != kThreadCount; ++i) {
+    threads.emplace_back([&, i] {
+      for (const auto& name_value : name_value_pairs[i]) {
+        try {
+          chunk_store_->Put(name_value.first, name_value.second);
+          ++stored;
+        } catch (const maidsafe_error& error) {
+          EXPECT_EQ(make_error_code(CommonErrors::cannot_exceed_limit), error.code());
+        }
+      }
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  EXPECT_EQ(kCapacity, stored.load());
+  EXPECT_EQ(kCapacity * (OneKB + ChunkOverhead), chunk_store_->CurrentDiskUsage().data);
+
+  std::uint32_t held(0);
+  for (const auto& thread_pairs : name_value_pairs) {
+    for (const auto& name_value : thread_pairs) {
+      if (chunk_store_->Has(name_value.first)) {
+        EXPECT_TRUE(chunk_store_->Get(name_value.first) == name_value.second);
+        ++held;
+      }
+    }
+  }
+  EXPECT_EQ(kCapacity, held);
+}
+
+TEST_F(ChunkStoreTest, FUNC_ConcurrentAccessScaling) {
+  const std::uint32_t kChunksPerThread(200);
+  const std::vector<std::uint32_t> kThreadCounts{1, 2, 4, 8};
+  for (const auto thread_count : kThreadCounts) {
+    maidsafe::test::TestPath test_path(
+        maidsafe::test::CreateTestPath("MaidSafe_Test_ChunkStore"));
+    const DiskUsage max_disk_usage(thread_count * kChunksPerThread * (OneKB + ChunkOverhead));
+    chunk_store_.reset(new ChunkStore(*test_path / "permanent_store", max_disk_usage));
+    std::vector<NameValueContainer> name_value_pairs(thread_count);
+    for (auto& thread_pairs : name_value_pairs)
+      AddRandomNameValuePairs(thread_pairs, kChunksPerThread, OneKB);
+
+    std::atomic<std::uint32_t> failures(0);
+    auto run_threads([&](std::function<void(const NameType&, const NonEmptyString&)> operation) {
+      std::vector<std::thread> threads;
+      for (std::uint32_t i(0); i != thread_count; ++i) {
+        threads.emplace_back([&, i] {
+          for (const auto& name_value : name_value_pairs[i]) {
+            try {
+              operation(name_value.first, name_value.second);
+            } catch (const std::exception&) {
+              ++failures;
+            }
+          }
+        });
+      }
+      for (auto& thread : threads)
+        thread.join();
+    });
+
+    pt::ptime start_time(pt::microsec_clock::universal_time());
+    run_threads([&](const NameType& name, const NonEmptyString& value) {
+      chunk_store_->Put(name, value);
+    });
+    std::cout << thread_count << " thread(s) performing " << kChunksPerThread
+              << " Puts each.  ";
+    PrintResult(start_time, pt::microsec_clock::universal_time());
+    ASSERT_EQ(0U, failures.load());
+    // Every reservation landed, filling the store exactly.
+    EXPECT_EQ(max_disk_usage.data, chunk_store_->CurrentDiskUsage().data);
+    NameType extra_name(MakeIdentity(), DataTypeId(RandomUint32()));
+    EXPECT_THROW(chunk_store_->Put(extra_name, NonEmptyString(RandomBytes(1))), maidsafe_error);
+
+    start_time = pt::microsec_clock::universal_time();
+    run_threads([&](const NameType& name, const NonEmptyString& value) {
+      if (chunk_store_->Get(name) != value)
+        ++failures;
+      chunk_store_->Delete(name);
+    });
+    std::cout << thread_count << " thread(s) performing " << kChunksPerThread
+              << " Get/Delete pairs each.  ";
+    PrintResult(start_time, pt::microsec_clock::universal_time());
+    EXPECT_EQ(0U, failures.load());
+    EXPECT_EQ(0U, chunk_store_->CurrentDiskUsage().data);
+  }
+}
+
+TEST_F(ChunkStoreTest, FUNC_DurabilityModes) {
+  const std::uint32_t kThreadCount(8), kChunksPerThread(50);
+  const std::vector<std::pair<ChunkStore::Durability, std::string>> kModes{
+      {ChunkStore::Durability::kBuffered, "Buffered"},
+      {ChunkStore::Durability::kAtomic, "Atomic"},
+      {ChunkStore::Durability::kGroupCommit, "Group commit"}};
+  for (const auto& mode : kModes) {
+    maidsafe::test::TestPath test_path(
+        maidsafe::test::CreateTestPath("MaidSafe_Test_ChunkStore"));
+    ChunkStore::Options options;
+    options.durability = mode.first;
+    chunk_store_.reset(new ChunkStore(
+        *test_path / "permanent_store",
+        DiskUsage(kThreadCount * kChunksPerThread * (OneKB + ChunkOverhead)), options));
+    std::vector<NameValueContainer> name_value_pairs(kThreadCount);
+    for (auto& thread_pairs : name_value_pairs)
+      AddRandomNameValuePairs(thread_pairs, kChunksPerThread, OneKB);
+
+    std::atomic<std::uint32_t> failures(0);
+    std::vector<std::thread> threads;
+    pt::ptime start_time(pt::microsec_clock::universal_time());
+    for (std::uint32_t i(0); i != kThreadCount; ++i) {
+      threads.emplace_back([&, i] {
+        for (const auto& name_value : name_value_pairs[i]) {
+          try {
+            chunk_store_->Put(name_value.first, name_value.second);
+          } catch (const std::exception&) {
+            ++failures;
+          }
+        }
+      });
+    }
+    for (auto& thread : threads)
+      thread.join();
+    pt::ptime stop_time(pt::microsec_clock::universal_time());
+    std::cout << mode.second << ": " << kThreadCount << " thread(s) performing "
+              << kChunksPerThread << " Puts each.  ";
+    PrintResult(start_time, stop_time);
+    EXPECT_EQ(0U, failures.load());
+  }
+}
+
+TEST_F(ChunkStoreTest, FUNC_RangeReadLatency) {
+  const std::uint64_t kValueSize(2 * OneKB * OneKB), kReadSize(4 * OneKB);
+  const std::uint32_t kReads(20);
+  const NameType name(MakeIdentity(), DataTypeId(0));
+  chunk_store_.reset(new ChunkStore(chunk_store_path_, DiskUsage(2 * kValueSize)));
+  ASSERT_NO_THROW(chunk_store_->Put(name, NonEmptyString(RandomBytes(kValueSize))));
+
+  pt::ptime start_time(pt::microsec_clock::universal_time());
+  for (std::uint32_t i(0); i != kReads; ++i)
+    EXPECT_EQ(kValueSize, chunk_store_->Get(name).string().size());
+  pt::ptime stop_time(pt::microsec_clock::universal_time());
+  std::cout << kReads << " full Gets of " << kValueSize << " bytes.  ";
+  PrintResult(start_time, stop_time);
+
+  start_time = pt::microsec_clock::universal_time();
+  for (std::uint32_t i(0); i != kReads; ++i) {
+    EXPECT_EQ(kReadSize,
+              chunk_store_->GetRange(name, i * (kValueSize / kReads), kReadSize).size());
+  }
+  stop_time = pt::microsec_clock::universal_time();
+  std::cout << kReads << " reads of " << kReadSize << " bytes from the same chunk.  ";
+  PrintResult(start_time, stop_time);
 }
 
 }  // namespace test
@@ -0,0 +1,66 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/vault/crc32c.h"
+
+#include <string>
+#include <vector>
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace maidsafe {
+
+namespace vault {
+
+namespace test {
+
+std::uint32_t Crc32c(const std::string& data) {
+  return vault::Crc32c(reinterpret_cast<const byte*>(data.data()), data.size());
+}
+
+TEST(Crc32cTest, BEH_KnownValues) {
+  // From RFC 3720, appendix B.4.
+  EXPECT_EQ(0U, Crc32c(""));
+  EXPECT_EQ(0xe3069283U, Crc32c("123456789"));
+  EXPECT_EQ(0x8a9136aaU, Crc32c(std::string(32, '\0')));
+  EXPECT_EQ(0x62a8ab43U, Crc32c(std::string(32, '\xff')));
+  std::string ascending;
+  for (int i(0); i != 32; ++i)
+    ascending.push_back(static_cast<char>(i));
+  EXPECT_EQ(0x46dd794eU, Crc32c(ascending));
+}
+
+TEST(Crc32cTest, BEH_Incremental) {
+  const std::vector<byte> data(RandomBytes(1000));
+  const std::uint32_t whole(vault::Crc32c(data.data(), data.size()));
+  // Split at every alignment, so that the hardware path's word loops meet the byte loop.
+  for (std::size_t split(0); split != 17; ++split) {
+    const std::uint32_t first(vault::Crc32c(data.data(), split));
+    EXPECT_EQ(whole, vault::Crc32c(data.data() + split, data.size() - split, first));
+  }
+  std::vector<byte> corrupted(data);
+  corrupted[500] ^= 0x01;
+  EXPECT_NE(whole, vault::Crc32c(corrupted.data(), corrupted.size()));
+}
+
+}  // namespace test
+
+}  // namespace vault
+
+}  // namespace maidsafe
@@ -52,6 +52,10 @@ TEST_F(DataManagerTest, BEH_HandlePutGet) {
   EXPECT_TRUE(put_result.valid());
   auto& put_pmid_holder(put_result.value());
   EXPECT_EQ(put_result.value().size(), 4);
+  // Putting it again is acknowledged without choosing new holders.
+  auto repeat_put_result(data_manager_.HandlePut(from, data));
+  EXPECT_FALSE(repeat_put_result.valid());
+  EXPECT_EQ(make_error_code(CommonErrors::success), repeat_put_result.error().code());
   auto get_result(data_manager_.HandleGet<ImmutableData>(from, data.Name()));
   EXPECT_TRUE(get_result.valid());
   auto& pmid_holders(boost::get<std::vector<routing::DestinationAddress>>(get_result.value()));
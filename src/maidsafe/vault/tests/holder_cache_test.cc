@@ -0,0 +1,119 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/vault/data_manager/holder_cache.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+
+namespace maidsafe {
+
+namespace vault {
+
+namespace test {
+
+HolderCache::Holders MakeHolders(int count) {
+  HolderCache::Holders holders;
+  for (int index(0); index < count; ++index)
+    holders.emplace_back(MakeIdentity());
+  return holders;
+}
+
+std::string ChunkName(int index) { return "chunk" + std::to_string(index); }
+
+TEST(HolderCacheTest, BEH_PutGetErase) {
+  HolderCache cache(100);
+  const HolderCache::Holders holders(MakeHolders(4));
+  EXPECT_FALSE(static_cast<bool>(cache.Get(ChunkName(0))));
+  EXPECT_FALSE(cache.Contains(ChunkName(0)));
+  cache.Put(ChunkName(0), holders);
+  auto cached(cache.Get(ChunkName(0)));
+  ASSERT_TRUE(static_cast<bool>(cached));
+  EXPECT_TRUE(*cached == holders);
+  EXPECT_TRUE(cache.Contains(ChunkName(0)));
+  EXPECT_EQ(2U, cache.Hits());
+  EXPECT_EQ(2U, cache.Misses());
+  EXPECT_EQ(1U, cache.Size());
+
+  // An empty holder list is a valid entry, distinct from no entry.
+  cache.Put(ChunkName(0), HolderCache::Holders());
+  cached = cache.Get(ChunkName(0));
+  ASSERT_TRUE(static_cast<bool>(cached));
+  EXPECT_TRUE(cached->empty());
+  EXPECT_EQ(1U, cache.Size());
+
+  cache.Erase(ChunkName(0));
+  EXPECT_FALSE(cache.Contains(ChunkName(0)));
+  EXPECT_EQ(0U, cache.Size());
+  cache.Erase(ChunkName(0));
+
+  HolderCache disabled_cache(0);
+  disabled_cache.Put(ChunkName(0), holders);
+  EXPECT_FALSE(disabled_cache.Contains(ChunkName(0)));
+  EXPECT_EQ(0U, disabled_cache.Size());
+}
+
+TEST(HolderCacheTest, BEH_Bounded) {
+  const int kCapacity(64);
+  HolderCache cache(kCapacity);
+  const HolderCache::Holders holders(MakeHolders(1));
+  for (int index(0); index < 100 * kCapacity; ++index) {
+    cache.Put(ChunkName(index), holders);
+    // Keep the first entry in use, so that it's never the least recently used in its shard.
+    EXPECT_TRUE(cache.Contains(ChunkName(0)));
+  }
+  // Each shard is bounded separately, and the capacity is rounded up to be divided between them.
+  EXPECT_LE(cache.Size(), static_cast<std::size_t>(2 * kCapacity));
+  EXPECT_TRUE(cache.Contains(ChunkName(0)));
+  EXPECT_FALSE(cache.Contains(ChunkName(1)));
+}
+
+TEST(HolderCacheTest, BEH_Concurrent) {
+  const int kThreads(8), kChunks(200);
+  HolderCache cache(kChunks);
+  std::vector<HolderCache::Holders> holders;
+  for (int index(0); index < kChunks; ++index)
+    holders.push_back(MakeHolders(index % 4));
+  std::vector<std::thread> threads;
+  for (int thread(0); thread < kThreads; ++thread) {
+    threads.emplace_back([&, thread] {
+      for (int index(thread); index < kChunks * 10; index += kThreads) {
+        const int chunk(index % kChunks);
+        cache.Put(ChunkName(chunk), holders[chunk]);
+        auto cached(cache.Get(ChunkName(chunk)));
+        if (cached)
+          EXPECT_TRUE(*cached == holders[chunk]);
+        if (index % 3 == 0)
+          cache.Erase(ChunkName(chunk));
+      }
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  EXPECT_EQ(static_cast<std::uint64_t>(kChunks * 10), cache.Hits() + cache.Misses());
+}
+
+}  // namespace test
+
+}  // namespace vault
+
+}  // namespace maidsafe
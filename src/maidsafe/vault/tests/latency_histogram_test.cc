@@ -0,0 +1,95 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/vault/latency_histogram.h"
+
+#include <thread>
+#include <vector>
+
+#include "maidsafe/common/test.h"
+
+namespace maidsafe {
+
+namespace vault {
+
+namespace test {
+
+TEST(LatencyHistogramTest, BEH_Empty) {
+  LatencyHistogram histogram;
+  auto summary(histogram.Summarise());
+  EXPECT_EQ(0U, summary.count);
+  EXPECT_EQ(0, summary.total.count());
+  EXPECT_EQ(0, summary.p99.count());
+  EXPECT_EQ(0, summary.max.count());
+}
+
+TEST(LatencyHistogramTest, BEH_Percentiles) {
+  LatencyHistogram histogram;
+  // 1 to 1000 microseconds, so each percentile is known exactly.
+  for (int i(1); i <= 1000; ++i)
+    histogram.Record(std::chrono::microseconds(i));
+  auto summary(histogram.Summarise());
+  EXPECT_EQ(1000U, summary.count);
+  EXPECT_EQ(std::chrono::microseconds(500500), summary.total);
+  EXPECT_EQ(std::chrono::nanoseconds(500500), summary.mean);
+  EXPECT_EQ(std::chrono::microseconds(1000), summary.max);
+  auto expect_near([](std::chrono::microseconds expected, std::chrono::nanoseconds actual) {
+    EXPECT_GE(actual, expected - expected / 8);
+    EXPECT_LE(actual, expected + expected / 8);
+  });
+  expect_near(std::chrono::microseconds(500), summary.p50);
+  expect_near(std::chrono::microseconds(900), summary.p90);
+  expect_near(std::chrono::microseconds(990), summary.p99);
+}
+
+TEST(LatencyHistogramTest, BEH_Extremes) {
+  LatencyHistogram histogram;
+  histogram.Record(std::chrono::nanoseconds(-5));
+  histogram.Record(std::chrono::nanoseconds(3));
+  histogram.Record(std::chrono::hours(1));
+  auto summary(histogram.Summarise());
+  EXPECT_EQ(3U, summary.count);
+  EXPECT_EQ(std::chrono::nanoseconds(3), summary.p50);
+  // Durations beyond the last bucket are reported no larger than the maximum recorded.
+  EXPECT_EQ(std::chrono::hours(1), summary.max);
+  EXPECT_LE(summary.p99, summary.max);
+}
+
+TEST(LatencyHistogramTest, BEH_ConcurrentRecording) {
+  const int kThreadCount(4), kRecordsPerThread(10000);
+  LatencyHistogram histogram;
+  std::vector<std::thread> threads;
+  for (int i(0); i != kThreadCount; ++i) {
+    threads.emplace_back([&, i] {
+      for (int j(0); j != kRecordsPerThread; ++j)
+        histogram.Record(std::chrono::nanoseconds(i * 1000 + j));
+    });
+  }
+  for (auto& thread : threads)
+    thread.join();
+  auto summary(histogram.Summarise());
+  EXPECT_EQ(static_cast<std::uint64_t>(kThreadCount * kRecordsPerThread), summary.count);
+  EXPECT_EQ(std::chrono::nanoseconds((kThreadCount - 1) * 1000 + kRecordsPerThread - 1),
+            summary.max);
+}
+
+}  // namespace test
+
+}  // namespace vault
+
+}  // namespace maidsafe
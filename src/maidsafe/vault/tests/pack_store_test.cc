@@ -0,0 +1,262 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/vault/pack_store.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+#include "boost/filesystem/operations.hpp"
+#include "boost/filesystem/path.hpp"
+
+#include "maidsafe/common/error.h"
+#include "maidsafe/common/test.h"
+#include "maidsafe/common/utils.h"
+#include "maidsafe/vault/tests/chunk_store_test_utils.h"
+
+namespace fs = boost::filesystem;
+
+namespace maidsafe {
+
+namespace vault {
+
+namespace test {
+
+const std::uint32_t kValueSize(1024);
+// Small enough that a handful of values spans several segments.
+const std::uint64_t kSegmentSize(4 * kValueSize);
+
+class PackStoreTest : public testing::Test {
+ protected:
+  typedef std::vector<std::pair<PackStore::NameType, NonEmptyString>> NameValueContainer;
+
+  PackStoreTest()
+      : test_path_(maidsafe::test::CreateTestPath("MaidSafe_Test_PackStore")),
+        root_(*test_path_ / "pack_store"),
+        pack_store_(new PackStore(root_, kSegmentSize)) {}
+
+  void Put(const NameValueContainer& name_value_pairs) {
+    for (const auto& name_value : name_value_pairs)
+      pack_store_->Put(name_value.first, name_value.second.string());
+  }
+
+  void ExpectStored(const PackStore::NameType& name, const NonEmptyString& value) {
+    auto content(pack_store_->Get(name));
+    ASSERT_TRUE(static_cast<bool>(content));
+    EXPECT_TRUE(*content == value.string());
+  }
+
+  std::uint64_t TotalSegmentBytes() {
+    std::uint64_t total(0);
+    for (fs::directory_iterator itr(root_); itr != fs::directory_iterator(); ++itr)
+      total += fs::file_size(itr->path());
+    return total;
+  }
+
+  maidsafe::test::TestPath test_path_;
+  fs::path root_;
+  std::unique_ptr<PackStore> pack_store_;
+};
+
+TEST_F(PackStoreTest, BEH_PutGetDelete) {
+  NameValueContainer name_value_pairs;
+  AddRandomNameValuePairs(name_value_pairs, 10, kValueSize);
+  Put(name_value_pairs);
+  EXPECT_EQ(10 * kValueSize, pack_store_->LiveBytes());
+  EXPECT_EQ(10U, pack_store_->Names().size());
+  for (const auto& name_value : name_value_pairs) {
+    ExpectStored(name_value.first, name_value.second);
+    EXPECT_EQ(kValueSize, *pack_store_->Size(name_value.first));
+  }
+
+  // Overwrite one value with a smaller one and delete another.
+  NonEmptyString new_value(RandomBytes(kValueSize / 2));
+  pack_store_->Put(name_value_pairs[0].first, new_value.string());
+  ExpectStored(name_value_pairs[0].first, new_value);
+  EXPECT_EQ(kValueSize, *pack_store_->Delete(name_value_pairs[1].first));
+  EXPECT_FALSE(pack_store_->Get(name_value_pairs[1].first));
+  EXPECT_FALSE(pack_store_->Size(name_value_pairs[1].first));
+  EXPECT_FALSE(pack_store_->Delete(name_value_pairs[1].first));
+  EXPECT_EQ(8 * kValueSize + kValueSize / 2, pack_store_->LiveBytes());
+  EXPECT_EQ(9U, pack_store_->Names().size());
+
+  // Names are visited in order from the first given, until the visitor stops.
+  auto names(pack_store_->Names());
+  std::sort(std::begin(names), std::end(names));
+  std::vector<PackStore::NameType> visited;
+  pack_store_->VisitNames(names[2], [&](const PackStore::NameType& name) {
+    visited.push_back(name);
+    return visited.size() != 3;
+  });
+  EXPECT_TRUE(std::vector<PackStore::NameType>(std::begin(names) + 2, std::begin(names) + 5) ==
+              visited);
+}
+
+TEST_F(PackStoreTest, BEH_Replay) {
+  NameValueContainer name_value_pairs;
+  AddRandomNameValuePairs(name_value_pairs, 10, kValueSize);
+  Put(name_value_pairs);
+  NonEmptyString new_value(RandomBytes(kValueSize));
+  pack_store_->Put(name_value_pairs[0].first, new_value.string());
+  pack_store_->Delete(name_value_pairs[1].first);
+  const std::uint64_t live_bytes(pack_store_->LiveBytes());
+
+  // Only one store may have the root open, so the old one must be closed first.
+  EXPECT_THROW(PackStore(root_, kSegmentSize), maidsafe_error);
+  pack_store_.reset();
+  pack_store_.reset(new PackStore(root_, kSegmentSize));
+  EXPECT_EQ(live_bytes, pack_store_->LiveBytes());
+  EXPECT_EQ(9U, pack_store_->Names().size());
+  ExpectStored(name_value_pairs[0].first, new_value);
+  EXPECT_FALSE(pack_store_->Get(name_value_pairs[1].first));
+  for (std::size_t i(2); i != name_value_pairs.size(); ++i)
+    ExpectStored(name_value_pairs[i].first, name_value_pairs[i].second);
+}
+
+TEST_F(PackStoreTest, BEH_TornRecord) {
+  NameValueContainer name_value_pairs;
+  AddRandomNameValuePairs(name_value_pairs, 2, kValueSize);
+  Put(name_value_pairs);
+  pack_store_.reset();
+
+  // Simulate a crash part way through appending a record.
+  fs::path last_segment;
+  for (fs::directory_iterator itr(root_); itr != fs::directory_iterator(); ++itr)
+    last_segment = std::max(last_segment, itr->path());
+  const std::uint64_t good_size(fs::file_size(last_segment));
+  {
+    std::ofstream segment(last_segment.string(), std::ios::binary | std::ios::app);
+    segment << "MSPK partial record";
+  }
+
+  pack_store_.reset(new PackStore(root_, kSegmentSize));
+  EXPECT_EQ(good_size, fs::file_size(last_segment));
+  EXPECT_EQ(2 * kValueSize, pack_store_->LiveBytes());
+  for (const auto& name_value : name_value_pairs)
+    ExpectStored(name_value.first, name_value.second);
+}
+
+TEST_F(PackStoreTest, BEH_CorruptSealedSegment) {
+  NameValueContainer name_value_pairs;
+  AddRandomNameValuePairs(name_value_pairs, 10, kValueSize);
+  Put(name_value_pairs);
+  EXPECT_LT(1U, pack_store_->SegmentCount());
+  pack_store_.reset();
+
+  // Overwrite the header of the second record in the oldest, sealed segment.
+  fs::path oldest_segment;
+  for (fs::directory_iterator itr(root_); itr != fs::directory_iterator(); ++itr) {
+    if (oldest_segment.empty() || itr->path() < oldest_segment)
+      oldest_segment = itr->path();
+  }
+  const std::uint64_t record_size(PackStore::SpaceRequired(name_value_pairs[0].first, kValueSize));
+  const std::uint64_t oldest_size(fs::file_size(oldest_segment));
+  const std::size_t oldest_count(static_cast<std::size_t>(oldest_size / record_size));
+  ASSERT_LT(1U, oldest_count);
+  {
+    std::fstream segment(oldest_segment.string(),
+                         std::ios::binary | std::ios::in | std::ios::out);
+    segment.seekp(record_size);
+    segment << "XXXX";
+  }
+
+  // The segment is kept whole rather than truncated, losing only the records after the corruption.
+  pack_store_.reset(new PackStore(root_, kSegmentSize));
+  EXPECT_EQ(oldest_size, fs::file_size(oldest_segment));
+  EXPECT_EQ(name_value_pairs.size() - oldest_count + 1, pack_store_->Names().size());
+  ExpectStored(name_value_pairs[0].first, name_value_pairs[0].second);
+  for (std::size_t i(1); i != oldest_count; ++i)
+    EXPECT_FALSE(pack_store_->Get(name_value_pairs[i].first));
+  for (std::size_t i(oldest_count); i != name_value_pairs.size(); ++i)
+    ExpectStored(name_value_pairs[i].first, name_value_pairs[i].second);
+
+  // Nor is it ever compacted away, even once its readable records are dead.
+  EXPECT_TRUE(static_cast<bool>(pack_store_->Delete(name_value_pairs[0].first)));
+  pack_store_->Compact();
+  pack_store_->Reclaim(record_size);
+  EXPECT_TRUE(fs::exists(oldest_segment));
+  EXPECT_EQ(oldest_size, fs::file_size(oldest_segment));
+}
+
+TEST_F(PackStoreTest, BEH_Compaction) {
+  NameValueContainer name_value_pairs;
+  AddRandomNameValuePairs(name_value_pairs, 20, kValueSize);
+  Put(name_value_pairs);
+  const std::size_t initial_segment_count(pack_store_->SegmentCount());
+  const std::uint64_t initial_bytes(TotalSegmentBytes());
+  EXPECT_LT(1U, initial_segment_count);
+
+  // Delete all but every fourth value, then compact synchronously.
+  NameValueContainer survivors;
+  for (std::size_t i(0); i != name_value_pairs.size(); ++i) {
+    if (i % 4 == 0)
+      survivors.push_back(name_value_pairs[i]);
+    else
+      EXPECT_TRUE(static_cast<bool>(pack_store_->Delete(name_value_pairs[i].first)));
+  }
+  pack_store_->Compact();
+  EXPECT_GT(initial_bytes, TotalSegmentBytes());
+  EXPECT_EQ(survivors.size() * kValueSize, pack_store_->LiveBytes());
+  for (const auto& name_value : survivors)
+    ExpectStored(name_value.first, name_value.second);
+
+  // Deleted values must not be resurrected by replaying what is left.
+  pack_store_.reset();
+  pack_store_.reset(new PackStore(root_, kSegmentSize));
+  EXPECT_EQ(survivors.size(), pack_store_->Names().size());
+  EXPECT_EQ(survivors.size() * kValueSize, pack_store_->LiveBytes());
+  for (const auto& name_value : survivors)
+    ExpectStored(name_value.first, name_value.second);
+}
+
+TEST_F(PackStoreTest, BEH_Reclaim) {
+  // A single segment, so that nothing is compacted in the background.
+  pack_store_.reset();
+  pack_store_.reset(new PackStore(root_, 64 * kSegmentSize));
+  std::atomic<std::uint64_t> reported(0);
+  EXPECT_EQ(0U, pack_store_->WatchReclaimed([&](std::uint64_t freed) { reported += freed; }));
+  NameValueContainer name_value_pairs;
+  AddRandomNameValuePairs(name_value_pairs, 8, kValueSize);
+  Put(name_value_pairs);
+  const auto& deleted_name(name_value_pairs[0].first);
+  const std::uint64_t record_size(PackStore::SpaceRequired(deleted_name, kValueSize));
+  const std::uint64_t tombstone_size(PackStore::SpaceRequired(deleted_name, 0));
+  EXPECT_EQ(8 * record_size, pack_store_->DiskBytes());
+  EXPECT_EQ(TotalSegmentBytes(), pack_store_->DiskBytes());
+
+  // One dead record is well below the compaction threshold, but is still reclaimed on demand.
+  pack_store_->Delete(deleted_name);
+  EXPECT_EQ(8 * record_size + tombstone_size, pack_store_->DiskBytes());
+  EXPECT_EQ(record_size + tombstone_size, pack_store_->Reclaim(1));
+  EXPECT_EQ(record_size + tombstone_size, reported.load());
+  EXPECT_EQ(7 * record_size, pack_store_->DiskBytes());
+  EXPECT_EQ(TotalSegmentBytes(), pack_store_->DiskBytes());
+  EXPECT_FALSE(pack_store_->Get(deleted_name));
+  for (std::size_t i(1); i != name_value_pairs.size(); ++i)
+    ExpectStored(name_value_pairs[i].first, name_value_pairs[i].second);
+  EXPECT_EQ(0U, pack_store_->Reclaim(1));
+}
+
+}  // namespace test
+
+}  // namespace vault
+
+}  // namespace maidsafe
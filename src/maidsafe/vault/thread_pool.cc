@@ -0,0 +1,124 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/vault/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+
+#include "maidsafe/common/log.h"
+
+namespace maidsafe {
+
+namespace vault {
+
+ThreadPool::ThreadPool(std::uint32_t thread_count)
+    : mutex_(), condition_(), tasks_(), stopping_(false), threads_() {
+  for (std::uint32_t i(0); i < std::max(thread_count, 1U); ++i)
+    threads_.emplace_back([this] { Run(); });
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  condition_.notify_all();
+  for (auto& thread : threads_)
+    thread.join();
+}
+
+void ThreadPool::Post(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.push_back(std::move(task));
+  }
+  condition_.notify_one();
+}
+
+void ThreadPool::ParallelFor(std::size_t count, std::function<void(std::size_t)> functor) {
+  // Shared with the posted helpers, which may only start after this call has returned.
+  struct State {
+    State(std::size_t count_in, std::function<void(std::size_t)> functor_in)
+        : count(count_in), functor(std::move(functor_in)), next(0), completed(0), mutex(),
+          condition(), error() {}
+    const std::size_t count;
+    const std::function<void(std::size_t)> functor;
+    std::atomic<std::size_t> next;
+    std::size_t completed;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::exception_ptr error;
+  };
+  auto state(std::make_shared<State>(count, std::move(functor)));
+  auto work([state] {
+    std::size_t index(0), done(0);
+    std::exception_ptr error;
+    while ((index = state->next++) < state->count) {
+      try {
+        state->functor(index);
+      } catch (...) {
+        if (!error)
+          error = std::current_exception();
+      }
+      ++done;
+    }
+    if (done == 0)
+      return;
+    std::lock_guard<std::mutex> lock(state->mutex);
+    if (error && !state->error)
+      state->error = error;
+    state->completed += done;
+    if (state->completed == state->count)
+      state->condition.notify_all();
+  });
+
+  const std::size_t helpers(std::min(threads_.size(), count > 0 ? count - 1 : 0));
+  for (std::size_t i(0); i != helpers; ++i)
+    Post(work);
+  work();
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->condition.wait(lock, [&] { return state->completed == state->count; });
+  if (state->error)
+    std::rethrow_exception(state->error);
+}
+
+void ThreadPool::Run() {
+  for (;;) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      condition_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+      if (tasks_.empty())
+        return;
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    try {
+      task();
+    } catch (const std::exception& e) {
+      LOG(kError) << "Thread pool task threw: " << boost::diagnostic_information(e);
+    }
+  }
+}
+
+}  // namespace vault
+
+}  // namespace maidsafe
@@ -0,0 +1,142 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#include "maidsafe/vault/transaction_batcher.h"
+
+#include <utility>
+
+#include "maidsafe/common/log.h"
+
+#include "maidsafe/vault/sqlite_utils.h"
+
+namespace maidsafe {
+
+namespace vault {
+
+TransactionBatcher::TransactionBatcher(sqlite::Database& database, std::mutex& database_mutex,
+                                       std::chrono::milliseconds window,
+                                       std::size_t max_batch_size,
+                                       std::function<void()> on_commit)
+    : database_(database),
+      database_mutex_(database_mutex),
+      kWindow_(window),
+      kMaxBatchSize_(max_batch_size == 0 ? 1 : max_batch_size),
+      kOnCommit_(std::move(on_commit)),
+      savepoint_statement_(database, "SAVEPOINT batched_write"),
+      release_statement_(database, "RELEASE batched_write"),
+      rollback_statement_(database, "ROLLBACK TO batched_write"),
+      mutex_(),
+      pending_condition_(),
+      complete_condition_(),
+      pending_(std::make_shared<Batch>()),
+      stopping_(false),
+      thread_([this] { Run(); }) {}
+
+TransactionBatcher::~TransactionBatcher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  pending_condition_.notify_one();
+  thread_.join();
+}
+
+void TransactionBatcher::Apply(Write write, std::function<void()> on_commit) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  std::shared_ptr<Batch> batch(pending_);
+  const std::size_t index(batch->writes.size());
+  batch->writes.push_back(std::move(write));
+  batch->on_commits.push_back(std::move(on_commit));
+  if (batch->writes.size() == 1 || batch->writes.size() == kMaxBatchSize_)
+    pending_condition_.notify_one();
+  complete_condition_.wait(lock, [&] { return batch->complete; });
+  if (batch->commit_error)
+    std::rethrow_exception(batch->commit_error);
+  if (batch->errors[index])
+    std::rethrow_exception(batch->errors[index]);
+}
+
+void TransactionBatcher::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    pending_condition_.wait(lock, [&] { return stopping_ || !pending_->writes.empty(); });
+    if (pending_->writes.empty())
+      return;
+    // Give other writers until the end of the window to join the batch.
+    pending_condition_.wait_for(
+        lock, kWindow_, [&] { return stopping_ || pending_->writes.size() >= kMaxBatchSize_; });
+    std::shared_ptr<Batch> batch(pending_);
+    pending_ = std::make_shared<Batch>();
+    lock.unlock();
+
+    Commit(*batch);
+
+    lock.lock();
+    batch->complete = true;
+    complete_condition_.notify_all();
+  }
+}
+
+void TransactionBatcher::Commit(Batch& batch) {
+  batch.errors.resize(batch.writes.size());
+  std::lock_guard<std::mutex> database_lock(database_mutex_);
+  try {
+    sqlite::Transaction transaction{database_};
+    for (std::size_t i(0); i != batch.writes.size(); ++i)
+      ApplyWrite(batch, i);
+    transaction.Commit();
+  } catch (const std::exception& e) {
+    LOG(kError) << "Failed to commit a batch of " << batch.writes.size()
+                << " writes: " << boost::diagnostic_information(e);
+    batch.commit_error = std::current_exception();
+    return;
+  }
+  for (std::size_t i(0); i != batch.writes.size(); ++i) {
+    if (batch.errors[i] || !batch.on_commits[i])
+      continue;
+    try {
+      batch.on_commits[i]();
+    } catch (const std::exception& e) {
+      LOG(kWarning) << "Post-commit action failed: " << boost::diagnostic_information(e);
+    }
+  }
+  if (!kOnCommit_)
+    return;
+  try {
+    kOnCommit_();
+  } catch (const std::exception& e) {
+    LOG(kWarning) << "Post-commit action failed: " << boost::diagnostic_information(e);
+  }
+}
+
+void TransactionBatcher::ApplyWrite(Batch& batch, std::size_t index) {
+  StepAndReset(savepoint_statement_);
+  try {
+    batch.writes[index]();
+  } catch (...) {
+    batch.errors[index] = std::current_exception();
+    // Failing to undo the write leaves the batch in an unknown state, so is allowed to fail the
+    // whole commit.
+    StepAndReset(rollback_statement_);
+  }
+  StepAndReset(release_statement_);
+}
+
+}  // namespace vault
+
+}  // namespace maidsafe
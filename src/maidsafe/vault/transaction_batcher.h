@@ -0,0 +1,98 @@
+/*  Copyright 2015 MaidSafe.net limited
+
+    This MaidSafe Software is licensed to you under (1) the MaidSafe.net Commercial License,
+    version 1.0 or later, or (2) The General Public License (GPL), version 3, depending on which
+    licence you accepted on initial access to the Software (the "Licences").
+
+    By contributing code to the MaidSafe Software, or to this project generally, you agree to be
+    bound by the terms of the MaidSafe Contributor Agreement, version 1.0, found in the root
+    directory of this project at LICENSE, COPYING and CONTRIBUTOR respectively and also
+    available at: http://www.maidsafe.net/licenses
+
+    Unless required by applicable law or agreed to in writing, the MaidSafe Software distributed
+    under the GPL Licence is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS
+    OF ANY KIND, either express or implied.
+
+    See the Licences for the specific language governing permissions and limitations relating to
+    use of the MaidSafe Software.                                                                 */
+
+#ifndef MAIDSAFE_VAULT_TRANSACTION_BATCHER_H_
+#define MAIDSAFE_VAULT_TRANSACTION_BATCHER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "maidsafe/common/sqlite3_wrapper.h"
+
+namespace maidsafe {
+
+namespace vault {
+
+// Shares the cost of committing SQLite transactions between concurrent writers, in the manner of
+// GroupCommitter.  Each caller of Apply adds its write to the open batch and blocks until a
+// background thread has run it, along with the rest of the batch, in a single transaction and
+// committed that.  A batch is committed once it has been open for 'window' or holds
+// 'max_batch_size' writes.
+class TransactionBatcher {
+ public:
+  using Write = std::function<void()>;
+
+  // Writes are run holding 'database_mutex', which must also guard any other use of 'database' and
+  // of the statements the writes use.  'on_commit', if set, is called after each commit while still
+  // holding it.
+  TransactionBatcher(sqlite::Database& database, std::mutex& database_mutex,
+                     std::chrono::milliseconds window, std::size_t max_batch_size,
+                     std::function<void()> on_commit = nullptr);
+  ~TransactionBatcher();
+  TransactionBatcher(const TransactionBatcher&) = delete;
+  TransactionBatcher(TransactionBatcher&&) = delete;
+  TransactionBatcher& operator=(const TransactionBatcher&) = delete;
+  TransactionBatcher& operator=(TransactionBatcher&&) = delete;
+
+  // Blocks until 'write' has been committed, and rethrows anything it threw.  Each write runs
+  // within a savepoint of its own, so one which fails part way is undone without affecting the
+  // others in its batch, but if the commit itself fails every write in the batch throws.
+  // 'on_commit', if set, is called once the write has succeeded and been committed, before the
+  // batch's 'on_commit' and while still holding 'database_mutex'.  The batch's writes are called
+  // back in the order they ran, so that e.g. a cache of the database can be updated in step.
+  void Apply(Write write, std::function<void()> on_commit = nullptr);
+
+ private:
+  struct Batch {
+    Batch() : writes(), on_commits(), errors(), commit_error(), complete(false) {}
+    std::vector<Write> writes;
+    std::vector<std::function<void()>> on_commits;
+    std::vector<std::exception_ptr> errors;
+    std::exception_ptr commit_error;
+    bool complete;
+  };
+
+  void Run();
+  void Commit(Batch& batch);
+  void ApplyWrite(Batch& batch, std::size_t index);
+
+  sqlite::Database& database_;
+  std::mutex& database_mutex_;
+  const std::chrono::milliseconds kWindow_;
+  const std::size_t kMaxBatchSize_;
+  const std::function<void()> kOnCommit_;
+  sqlite::Statement savepoint_statement_, release_statement_, rollback_statement_;
+  std::mutex mutex_;
+  std::condition_variable pending_condition_, complete_condition_;
+  std::shared_ptr<Batch> pending_;
+  bool stopping_;
+  std::thread thread_;
+};
+
+}  // namespace vault
+
+}  // namespace maidsafe
+
+#endif  // MAIDSAFE_VAULT_TRANSACTION_BATCHER_H_
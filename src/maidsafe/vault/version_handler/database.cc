@@ -25,12 +25,21 @@
 #include "maidsafe/common/log.h"
 #include "maidsafe/common/utils.h"
 
+#include "maidsafe/vault/sqlite_utils.h"
+
 namespace maidsafe {
 
 namespace vault {
 
 VersionHandlerDatabase::VersionHandlerDatabase(const boost::filesystem::path& db_path)
-  : database_(), seeking_statement_(), kDbPath_(db_path), write_operations_(0) {
+  : database_(),
+    seeking_statement_(),
+    put_statement_(),
+    get_statement_(),
+    delete_statement_(),
+    mutex_(),
+    kDbPath_(db_path),
+    write_operations_(0) {
   database_.reset(new sqlite::Database(db_path, sqlite::Mode::kReadWriteCreate));
   std::string query(
       "CREATE TABLE IF NOT EXISTS KeyValuePairs ("
@@ -39,20 +48,28 @@ VersionHandlerDatabase::VersionHandlerDatabase(const boost::filesystem::path& db
   sqlite::Statement statement{*database_, query};
   statement.Step();
   transaction.Commit();
+
+  put_statement_.reset(new sqlite::Statement(
+      *database_, "INSERT OR REPLACE INTO KeyValuePairs (KEY, VALUE) VALUES (?, ?)"));
+  get_statement_.reset(
+      new sqlite::Statement(*database_, "SELECT VALUE FROM KeyValuePairs WHERE KEY=?"));
+  delete_statement_.reset(
+      new sqlite::Statement(*database_, "DELETE FROM KeyValuePairs WHERE KEY=?"));
 }
 
 void VersionHandlerDatabase::Put(const KEY& key, const VALUE& value) {
   if (!database_)
     BOOST_THROW_EXCEPTION(MakeError(CommonErrors::db_not_present));
+  std::lock_guard<std::mutex> lock(mutex_);
   CheckPoint();
 
   sqlite::Transaction transaction{*database_};
-  std::string query(
-      "INSERT OR REPLACE INTO KeyValuePairs (KEY, VALUE) VALUES (?, ?)");
-  sqlite::Statement statement{*database_, query};
-  statement.BindText(1, key);
-  statement.BindText(2, value);
-  statement.Step();
+  {
+    ScopedStatementReset reset(*put_statement_);
+    put_statement_->BindText(1, key);
+    put_statement_->BindText(2, value);
+    put_statement_->Step();
+  }
   transaction.Commit();
 }
 
@@ -60,25 +77,25 @@ void VersionHandlerDatabase::Get(const KEY& key, VALUE& value) {
   if (!database_)
     BOOST_THROW_EXCEPTION(MakeError(CommonErrors::db_not_present));
 
-  std::string query(
-      "SELECT VALUE FROM KeyValuePairs WHERE KEY=?");
-  sqlite::Statement statement{*database_, query};
-  statement.BindText(1, key);
-  if (statement.Step() == sqlite::StepResult::kSqliteRow)
-    value = statement.ColumnText(0);
+  std::lock_guard<std::mutex> lock(mutex_);
+  ScopedStatementReset reset(*get_statement_);
+  get_statement_->BindText(1, key);
+  if (get_statement_->Step() == sqlite::StepResult::kSqliteRow)
+    value = get_statement_->ColumnText(0);
 }
 
 void VersionHandlerDatabase::Delete(const KEY& key) {
   if (!database_)
     BOOST_THROW_EXCEPTION(MakeError(CommonErrors::db_not_present));
+  std::lock_guard<std::mutex> lock(mutex_);
   CheckPoint();
 
   sqlite::Transaction transaction{*database_};
-  std::string query(
-      "DELETE FROM KeyValuePairs WHERE KEY=?");
-  sqlite::Statement statement{*database_, query};
-  statement.BindText(1, key);
-  statement.Step();
+  {
+    ScopedStatementReset reset(*delete_statement_);
+    delete_statement_->BindText(1, key);
+    delete_statement_->Step();
+  }
   transaction.Commit();
 }
 
@@ -102,6 +119,11 @@ bool VersionHandlerDatabase::SeekNext(std::pair<KEY, VALUE>& result) {
 
 VersionHandlerDatabase::~VersionHandlerDatabase() {
   try {
+    // Statements must be finalised before their database is closed.
+    seeking_statement_.reset();
+    put_statement_.reset();
+    get_statement_.reset();
+    delete_statement_.reset();
     database_.reset();
     boost::filesystem::remove_all(kDbPath_);
   }
@@ -19,6 +19,8 @@
 #ifndef MAIDSAFE_VAULT_VERSION_HANDLER_DATABASE_H_
 #define MAIDSAFE_VAULT_VERSION_HANDLER_DATABASE_H_
 
+#include <memory>
+#include <mutex>
 #include <string>
 #include <utility>
 
@@ -45,6 +47,10 @@ class VersionHandlerDatabase {
 
   std::unique_ptr<sqlite::Database> database_;
   std::unique_ptr<sqlite::Statement> seeking_statement_;
+  // Prepared once and reused, so that SQLite doesn't re-parse and re-plan each query.  'mutex_'
+  // serialises their use.
+  std::unique_ptr<sqlite::Statement> put_statement_, get_statement_, delete_statement_;
+  std::mutex mutex_;
   const boost::filesystem::path kDbPath_;
   int write_operations_;
 };